@@ -0,0 +1,137 @@
+// Registering a list of students to one course: one AddStudentToCourse()
+// per ID, as the CLI does for "reg", against the bulk overload that merges
+// the sorted IDs into the roster in one pass. The lists hold duplicates and
+// unknown IDs, and the course fills up part of the way through; the
+// outcomes and the rosters of both are checked to be the same.
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "../src/manager.h"
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+double Seconds(Clock::time_point begin)
+{
+    return std::chrono::duration<double>(Clock::now() - begin).count();
+}
+
+const SAM::StudentInfo::IDType kFirstID = 2010010000ULL;
+
+void Fill(SAM::Manager &manager, const SAM::CourseInfo &info,
+          std::size_t student_num, std::size_t enrolled_num)
+{
+    manager.AddCourse(info);
+    for (std::size_t i = 0; i < student_num; i++)
+        manager.AddStudent(SAM::StudentInfo{kFirstID + i, "name", true, 0});
+
+    std::vector<SAM::Manager::SavedRoster> rosters(1);
+    rosters[0].first = manager.FindCourseHandle(info.id);
+    for (std::size_t i = 0; i < enrolled_num; i++)
+    {
+        rosters[0].second.push_back(
+                SAM::ScorePiece{kFirstID + i * 2, SAM::kInvalidScore});
+    }
+    SAM::RosterLoadSummary summary;
+    manager.LoadRosters(rosters, false, summary);
+}
+
+// what "reg" for each ID amounts to
+void AddOneByOne(SAM::Manager &manager, const SAM::CourseInfo &info,
+                 const std::vector<SAM::StudentInfo::IDType> &ids,
+                 std::vector<SAM::EnrollOutcome> &outcomes)
+{
+    const SAM::Course &course = *manager.FindCourse(info.id);
+    outcomes.resize(ids.size());
+    for (std::size_t i = 0; i < ids.size(); i++)
+    {
+        outcomes[i].id = ids[i];
+        if (!manager.HasStudent(ids[i]))
+            outcomes[i].status = SAM::EnrollOutcome::UNKNOWN_STUDENT;
+        else if (course.HasStudent(ids[i]))
+            outcomes[i].status = SAM::EnrollOutcome::ALREADY_ENROLLED;
+        else if (manager.AddStudentToCourse(ids[i], info.id))
+            outcomes[i].status = SAM::EnrollOutcome::ADDED;
+        else
+            outcomes[i].status = SAM::EnrollOutcome::OVER_CAPACITY;
+    }
+}
+
+bool SameRoster(const SAM::Manager &lhs, const SAM::Manager &rhs,
+                const SAM::CourseInfo &info)
+{
+    SAM::RosterView left = lhs.FindCourse(info.id)->final_score();
+    SAM::RosterView right = rhs.FindCourse(info.id)->final_score();
+    if (left.size() != right.size())
+        return false;
+    for (std::size_t i = 0; i < left.size(); i++)
+    {
+        if (left.ids()[i] != right.ids()[i])
+            return false;
+    }
+    return true;
+}
+
+// enrolled_num students already in the course (every other one), a list of
+// request_num IDs drawn from a range a tenth wider than the students, one in
+// ten of them repeating an earlier one, and seats for about half of the new
+// ones
+void Run(std::size_t student_num, std::size_t enrolled_num,
+         std::size_t request_num)
+{
+    std::mt19937 rng(request_num);
+    SAM::CourseInfo info{"2014秋-1", "course", 0, 2,
+                         enrolled_num + request_num / 2, "teacher"};
+
+    SAM::Manager one_by_one, bulk;
+    Fill(one_by_one, info, student_num, enrolled_num);
+    Fill(bulk, info, student_num, enrolled_num);
+
+    std::vector<SAM::StudentInfo::IDType> ids(request_num);
+    for (std::size_t i = 0; i < request_num; i++)
+    {
+        if (i % 10 == 9)
+            ids[i] = ids[rng() % i];
+        else
+            ids[i] = kFirstID + rng() % (student_num + student_num / 10);
+    }
+
+    std::vector<SAM::EnrollOutcome> expected, outcomes;
+    auto begin = Clock::now();
+    AddOneByOne(one_by_one, info, ids, expected);
+    double one_by_one_seconds = Seconds(begin);
+
+    begin = Clock::now();
+    bulk.AddStudentToCourse(ids, info.id, outcomes);
+    double bulk_seconds = Seconds(begin);
+
+    std::size_t counts[4] = {0, 0, 0, 0};
+    std::size_t mismatches = 0;
+    for (std::size_t i = 0; i < ids.size(); i++)
+    {
+        counts[outcomes[i].status]++;
+        if (outcomes[i].id != expected[i].id ||
+            outcomes[i].status != expected[i].status)
+            mismatches++;
+    }
+
+    std::printf("%6zu enrolled + %6zu requests  one by one %9.2f ms  "
+                "bulk %7.2f ms  added %zu, enrolled %zu, unknown %zu, "
+                "over %zu  mismatches %zu%s\n",
+                enrolled_num, request_num, one_by_one_seconds * 1e3,
+                bulk_seconds * 1e3, counts[0], counts[1], counts[2],
+                counts[3], mismatches,
+                SameRoster(one_by_one, bulk, info) ? "" : "  ROSTERS DIFFER");
+}
+
+}  // namespace
+
+int main()
+{
+    for (std::size_t request_num : {100, 1000, 3000})
+        Run(100000, 20000, request_num);
+    return 0;
+}
@@ -0,0 +1,158 @@
+// GPA of every student: walking the courses each time, as transcripts used
+// to, against the totals the manager keeps, for more and more courses per
+// student. The totals are checked against the rosters afterwards.
+// Then the ranking: built once, kept up to date with score changes, and
+// asked for the rank of every student.
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../src/manager.h"
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+double Seconds(Clock::time_point begin)
+{
+    return std::chrono::duration<double>(Clock::now() - begin).count();
+}
+
+// what GenerateTranscript used to do for the GPA
+SAM::ScoreType WalkGPA(const SAM::Manager &manager,
+                       const SAM::Student &student)
+{
+    double weighted_sum = 0;
+    int total_credit = 0;
+    for (SAM::CourseHandle handle : student.courses_taken())
+    {
+        const SAM::Course &course = manager.course(handle);
+        SAM::ScoreType score = course.GetScore(student.info().id);
+        if (score != SAM::kInvalidScore)
+        {
+            weighted_sum += double(score) * course.info().credit;
+            total_credit += course.info().credit;
+        }
+    }
+    return total_credit != 0 ?
+               static_cast<SAM::ScoreType>(weighted_sum / total_credit) :
+               SAM::kInvalidScore;
+}
+
+void Run(std::size_t student_num, std::size_t courses_per_student)
+{
+    const std::size_t course_num = 2000;
+    std::mt19937 rng(courses_per_student);
+
+    SAM::Manager manager;
+    for (std::size_t i = 0; i < course_num; i++)
+    {
+        manager.AddCourse(SAM::CourseInfo{
+                "2014秋-" + std::to_string(i), "course", 0,
+                static_cast<int>(1 + rng() % 5), student_num, "teacher"});
+    }
+
+    std::vector<SAM::Manager::SavedRoster> rosters(course_num);
+    for (std::size_t i = 0; i < course_num; i++)
+        rosters[i].first = static_cast<SAM::CourseHandle>(i);
+    for (std::size_t i = 0; i < student_num; i++)
+    {
+        SAM::StudentInfo::IDType id = 2010010000ULL + i;
+        manager.AddStudent(SAM::StudentInfo{id, "name", true, 0});
+        for (std::size_t k = 0; k < courses_per_student; k++)
+        {
+            rosters[rng() % course_num].second.push_back(
+                    SAM::ScorePiece{id, static_cast<SAM::ScoreType>(
+                                                40 + rng() % 61)});
+        }
+    }
+    SAM::RosterLoadSummary summary;
+    manager.LoadRosters(rosters, false, summary);
+
+    // a term of score changes
+    std::vector<std::pair<SAM::StudentInfo::IDType,
+                          SAM::CourseInfo::IDType>> changes;
+    for (auto iter = manager.student_begin(); iter != manager.student_end();
+         ++iter)
+    {
+        for (SAM::CourseHandle handle : iter->courses_taken())
+        {
+            if (rng() % 4 == 0)
+                changes.emplace_back(iter->info().id,
+                                     manager.course(handle).info().id);
+        }
+    }
+    auto begin = Clock::now();
+    for (const auto &change : changes)
+    {
+        manager.ChangeScore(change.first, change.second,
+                            static_cast<SAM::ScoreType>(rng() % 101));
+    }
+    double change_seconds = Seconds(begin);
+
+    double walk_sum = 0, kept_sum = 0;
+    begin = Clock::now();
+    for (auto iter = manager.student_begin(); iter != manager.student_end();
+         ++iter)
+        walk_sum += WalkGPA(manager, *iter);
+    double walk_seconds = Seconds(begin);
+
+    begin = Clock::now();
+    for (auto iter = manager.student_begin(); iter != manager.student_end();
+         ++iter)
+        kept_sum += iter->gpa();
+    double kept_seconds = Seconds(begin);
+
+    std::printf("%3zu courses/student  GPA queries: walk %7.2f Mq/s  kept "
+                "%7.2f Mq/s  %zu score changes %6.2f Mop/s  check %s "
+                "(%.1f %.1f)\n",
+                courses_per_student,
+                student_num / walk_seconds / 1e6,
+                student_num / kept_seconds / 1e6,
+                changes.size(), changes.size() / change_seconds / 1e6,
+                manager.CheckCredits() ? "ok" : "FAILED",
+                walk_sum / student_num, kept_sum / student_num);
+
+    begin = Clock::now();
+    manager.Ranking();
+    double build_seconds = Seconds(begin);
+
+    const std::size_t update_num = 10000;
+    begin = Clock::now();
+    for (std::size_t i = 0; i < update_num; i++)
+    {
+        const auto &change = changes[rng() % changes.size()];
+        manager.ChangeScore(change.first, change.second,
+                            static_cast<SAM::ScoreType>(rng() % 101));
+        manager.Ranking();
+    }
+    double update_seconds = Seconds(begin);
+
+    std::size_t rank_sum = 0;
+    const SAM::GpaRanking &ranking = manager.Ranking();
+    begin = Clock::now();
+    for (auto iter = manager.student_begin(); iter != manager.student_end();
+         ++iter)
+    {
+        SAM::GpaRanking::Entry entry;
+        if (ranking.Find(iter.handle(), false, entry))
+            rank_sum += entry.rank;
+    }
+    double rank_seconds = Seconds(begin);
+
+    std::printf("%22s ranking: build %6.3f s  change + update %6.2f us  "
+                "rank %6.2f Mq/s  (%zu)\n",
+                "", build_seconds, update_seconds / update_num * 1e6,
+                student_num / rank_seconds / 1e6, rank_sum);
+}
+
+}  // namespace
+
+int main()
+{
+    for (std::size_t courses_per_student : {4, 16, 64})
+        Run(50000, courses_per_student);
+    return 0;
+}
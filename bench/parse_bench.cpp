@@ -0,0 +1,121 @@
+// Records per second of parsing a students.dat-like file: one
+// istringstream per line (as ManagerReader used to) against TextParser.
+#include <chrono>
+#include <cstdio>
+#include <sstream>
+#include <string>
+
+#include "../src/common.h"
+#include "../src/text_parser.h"
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+double Seconds(Clock::time_point begin)
+{
+    return std::chrono::duration<double>(Clock::now() - begin).count();
+}
+
+std::string MakeStudentFile(std::size_t n)
+{
+    std::string text;
+    for (std::size_t i = 0; i < n; i++)
+    {
+        SAM::StudentInfo info{2010010000ULL + i * 7, "学生" + std::to_string(i),
+                              i % 3 != 0, static_cast<int>(i % 46)};
+        text += SAM::to_string(info);
+        text += '\n';
+    }
+    return text;
+}
+
+std::string MakeRosterLine(std::size_t n)
+{
+    std::string text;
+    for (std::size_t i = 0; i < n; i++)
+    {
+        text += std::to_string(2010010000ULL + i * 7) + ' ';
+        text += (i % 10 == 0 ? "-1" : std::to_string(50 + i % 50) + ".5");
+        text += ' ';
+    }
+    text += '\n';
+    return text;
+}
+
+}  // namespace
+
+int main()
+{
+    const std::size_t kStudents = 1000000;
+
+    std::string students = MakeStudentFile(kStudents);
+    std::string roster = MakeRosterLine(kStudents);
+
+    // students, istringstream per line
+    std::size_t checksum = 0;
+    auto begin = Clock::now();
+    {
+        std::istringstream fin(students);
+        std::string line;
+        while (std::getline(fin, line))
+        {
+            std::istringstream iss(line);
+            SAM::StudentInfo info;
+            if (iss >> info.id >> info.name >> info.is_male >> info.department)
+                checksum += info.department;
+        }
+    }
+    double stream_time = Seconds(begin);
+
+    begin = Clock::now();
+    {
+        SAM::TextParser parser(students);
+        while (parser.NextNonBlankLine())
+        {
+            SAM::StudentInfo info;
+            if (parser.ReadStudentInfo(info) && parser.ExpectLineEnd())
+                checksum -= info.department;
+        }
+    }
+    double parser_time = Seconds(begin);
+
+    std::printf("students.dat, %zu records\n", kStudents);
+    std::printf("    istringstream  %8.3f s  %10.0f records/s\n",
+                stream_time, kStudents / stream_time);
+    std::printf("    TextParser     %8.3f s  %10.0f records/s\n",
+                parser_time, kStudents / parser_time);
+
+    // one roster line of (ID, score) pairs
+    double score_sum = 0;
+    begin = Clock::now();
+    {
+        std::istringstream iss(roster);
+        SAM::ScorePiece piece;
+        while (iss >> piece.id >> piece.score)
+            score_sum += piece.score;
+    }
+    stream_time = Seconds(begin);
+
+    begin = Clock::now();
+    {
+        SAM::TextParser parser(roster);
+        SAM::ScorePiece piece;
+        parser.NextLine();
+        while (!parser.AtLineEnd() &&
+               parser.ReadUInt64("student ID", piece.id) &&
+               parser.ReadScore("score", piece.score))
+            score_sum -= piece.score;
+    }
+    parser_time = Seconds(begin);
+
+    std::printf("roster pairs, %zu records\n", kStudents);
+    std::printf("    istringstream  %8.3f s  %10.0f records/s\n",
+                stream_time, kStudents / stream_time);
+    std::printf("    TextParser     %8.3f s  %10.0f records/s\n",
+                parser_time, kStudents / parser_time);
+
+    // both sums shall be back to zero
+    std::printf("checksum %zu %g\n", checksum, score_sum);
+    return 0;
+}
@@ -0,0 +1,121 @@
+// Compare the scalar and AVX2 score kernels, and both with a scan over
+// FinalScore records, on columns about the size of a course roster.
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "../src/score_kernels.h"
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+double Seconds(Clock::time_point begin)
+{
+    return std::chrono::duration<double>(Clock::now() - begin).count();
+}
+
+struct Result
+{
+    double seconds;
+    SAM::ScoreSummary summary;
+    std::size_t above;
+};
+
+// One pass of min/max/mean and a count above 60 per round
+Result RunRecords(const SAM::FinalScore &records, int rounds)
+{
+    Result result{0, SAM::ScoreSummary(), 0};
+    auto begin = Clock::now();
+    for (int round = 0; round < rounds; round++)
+    {
+        SAM::ScoreSummary summary{0, 1000, -1000, 0, 0};
+        std::size_t above = 0;
+        for (const SAM::ScorePiece &piece : records)
+        {
+            if (piece.score == SAM::kInvalidScore)
+                continue;
+            summary.count++;
+            if (piece.score < summary.min_score)
+                summary.min_score = piece.score;
+            if (piece.score > summary.max_score)
+                summary.max_score = piece.score;
+            summary.sum += piece.score;
+            summary.sum_of_squares += double(piece.score) * piece.score;
+            above += piece.score > 60;
+        }
+        result.summary = summary;
+        result.above = above;
+    }
+    result.seconds = Seconds(begin);
+    return result;
+}
+
+Result RunKernels(SAM::ScoreKernels kernels,
+                  const std::vector<SAM::ScoreType> &scores, int rounds)
+{
+    Result result{0, SAM::ScoreSummary(), 0};
+    if (!SAM::SelectScoreKernels(kernels))
+        return result;
+
+    auto begin = Clock::now();
+    for (int round = 0; round < rounds; round++)
+    {
+        result.summary = SAM::SummarizeScores(scores.data(), scores.size());
+        result.above = SAM::CountAbove(scores.data(), scores.size(), 60);
+    }
+    result.seconds = Seconds(begin);
+    return result;
+}
+
+void Run(std::size_t n)
+{
+    std::mt19937 rng(n);
+    std::normal_distribution<SAM::ScoreType> score(75, 12);
+    std::uniform_int_distribution<int> percent(0, 99);
+
+    SAM::FinalScore records(n);
+    std::vector<SAM::ScoreType> scores(n);
+    for (std::size_t i = 0; i < n; i++)
+    {
+        SAM::ScoreType value = percent(rng) < 5 ? SAM::kInvalidScore :
+                                                  score(rng);
+        records[i] = SAM::ScorePiece{2010010000ULL + i, value};
+        scores[i] = value;
+    }
+
+    int rounds = static_cast<int>(200000000 / n);
+    Result aos = RunRecords(records, rounds);
+    Result scalar = RunKernels(SAM::kScalarKernels, scores, rounds);
+    Result avx2 = RunKernels(SAM::kAvx2Kernels, scores, rounds);
+
+    auto rate = [&](const Result &result) {
+        return result.seconds > 0 ? double(n) * rounds / result.seconds / 1e9
+                                  : 0.0;
+    };
+    bool same = scalar.summary.count == aos.summary.count &&
+                scalar.above == aos.above &&
+                scalar.summary.min_score == aos.summary.min_score &&
+                scalar.summary.max_score == aos.summary.max_score &&
+                (avx2.seconds == 0 ||
+                 (avx2.summary.count == scalar.summary.count &&
+                  avx2.above == scalar.above &&
+                  avx2.summary.min_score == scalar.summary.min_score &&
+                  avx2.summary.max_score == scalar.summary.max_score));
+
+    std::printf("%8zu scores  records %6.2f  scalar %6.2f  avx2 %6.2f"
+                " Gscore/s  mean %.3f  sd^2 %.3f  %s\n",
+                n, rate(aos), rate(scalar), rate(avx2),
+                scalar.summary.mean(), scalar.summary.variance(),
+                same ? "same" : "DIFFERENT");
+}
+
+}  // namespace
+
+int main()
+{
+    for (std::size_t n : {100, 1000, 10000, 100000})
+        Run(n);
+    return 0;
+}
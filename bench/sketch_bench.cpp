@@ -0,0 +1,171 @@
+// Rank queries in a large course while its scores keep changing: the
+// course statistics, sorted again after every change, against the sketch
+// kept up to date. Scores have one decimal here, so the sketch is not exact;
+// its answers are checked against the bounds ScoreSketch promises.
+// Then percentiles of the whole university: merging the sketches of every
+// course against sorting every score.
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../src/manager.h"
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+double Seconds(Clock::time_point begin)
+{
+    return std::chrono::duration<double>(Clock::now() - begin).count();
+}
+
+SAM::ScoreType RandomScore(std::mt19937 &rng)
+{
+    return static_cast<SAM::ScoreType>(rng() % 1001) / 10;
+}
+
+// Where the sketch may be off: by the scores less than resolution away
+bool WithinBounds(const std::vector<SAM::ScoreType> &sorted,
+                  double resolution, SAM::ScoreType score, int rank)
+{
+    auto count_above = [&sorted](double bound)
+    {
+        return sorted.end() -
+               std::upper_bound(sorted.begin(), sorted.end(), bound);
+    };
+    int exact = 1 + static_cast<int>(count_above(score));
+    int low = 1 + static_cast<int>(count_above(score + resolution));
+    return rank <= exact && rank >= low;
+}
+
+void RunCourse(std::size_t student_num, double resolution)
+{
+    std::mt19937 rng(student_num);
+    SAM::Manager manager;
+    manager.SetSketchResolution(resolution);
+    SAM::CourseInfo info{"2014秋-1", "course", 0, 2, student_num, "teacher"};
+    manager.AddCourse(info);
+
+    std::vector<SAM::Manager::SavedRoster> rosters(1);
+    rosters[0].first = 0;
+    for (std::size_t i = 0; i < student_num; i++)
+    {
+        SAM::StudentInfo::IDType id = 2010010000ULL + i;
+        manager.AddStudent(SAM::StudentInfo{id, "name", true, 0});
+        rosters[0].second.push_back(SAM::ScorePiece{id, RandomScore(rng)});
+    }
+    SAM::RosterLoadSummary summary;
+    manager.LoadRosters(rosters, false, summary);
+    const SAM::Course &course = manager.course(0);
+
+    const std::size_t change_num = 2000;
+    std::vector<SAM::ScoreType> queries(change_num);
+    std::vector<SAM::StudentInfo::IDType> ids(change_num);
+    for (std::size_t i = 0; i < change_num; i++)
+    {
+        queries[i] = RandomScore(rng);
+        ids[i] = 2010010000ULL + rng() % student_num;
+    }
+
+    long long exact_sum = 0, sketch_sum = 0;
+    std::size_t out_of_bounds = 0;
+    double exact_seconds = 0, sketch_seconds = 0;
+    for (std::size_t i = 0; i < change_num; i++)
+    {
+        manager.ChangeScore(ids[i], info.id, RandomScore(rng));
+
+        auto begin = Clock::now();
+        auto statistics = course.statistics();
+        int exact = statistics->Rank(queries[i]);
+        exact_seconds += Seconds(begin);
+
+        begin = Clock::now();
+        int approximate = course.sketch().Rank(queries[i]);
+        sketch_seconds += Seconds(begin);
+
+        exact_sum += exact;
+        sketch_sum += approximate;
+        if (!WithinBounds(statistics->sorted_scores(), resolution,
+                          queries[i], approximate))
+            out_of_bounds++;
+    }
+
+    std::printf("%6zu students  resolution %4.1f  change + rank: sorted "
+                "%8.2f us  sketch %6.3f us  mean rank %.1f/%.1f  out of "
+                "bounds %zu\n",
+                student_num, resolution,
+                exact_seconds / change_num * 1e6,
+                sketch_seconds / change_num * 1e6,
+                double(exact_sum) / change_num,
+                double(sketch_sum) / change_num, out_of_bounds);
+}
+
+void RunUniversity(std::size_t course_num, std::size_t students_per_course)
+{
+    std::mt19937 rng(course_num);
+    SAM::Manager manager;
+    std::vector<SAM::Manager::SavedRoster> rosters(course_num);
+    for (std::size_t i = 0; i < course_num; i++)
+    {
+        manager.AddCourse(SAM::CourseInfo{
+                "2014秋-" + std::to_string(i), "course",
+                static_cast<int>(i % SAM::kDepartmentNum), 2,
+                students_per_course, "teacher"});
+        rosters[i].first = static_cast<SAM::CourseHandle>(i);
+    }
+    for (std::size_t i = 0; i < students_per_course * 4; i++)
+    {
+        SAM::StudentInfo::IDType id = 2010010000ULL + i;
+        manager.AddStudent(SAM::StudentInfo{id, "name", true, 0});
+    }
+    for (auto &roster : rosters)
+    {
+        for (std::size_t i = 0; i < students_per_course; i++)
+        {
+            roster.second.push_back(SAM::ScorePiece{
+                    2010010000ULL + i * 4 + rng() % 4, RandomScore(rng)});
+        }
+    }
+    SAM::RosterLoadSummary summary;
+    manager.LoadRosters(rosters, false, summary);
+
+    auto begin = Clock::now();
+    std::vector<SAM::ScoreType> scores;
+    for (auto iter = manager.course_begin(); iter != manager.course_end();
+         ++iter)
+    {
+        SAM::RosterView roster = iter->final_score();
+        scores.insert(scores.end(), roster.scores(),
+                      roster.scores() + roster.size());
+    }
+    std::sort(scores.begin(), scores.end());
+    SAM::ScoreType exact_median = scores[(scores.size() + 1) / 2 - 1];
+    double sort_seconds = Seconds(begin);
+
+    begin = Clock::now();
+    SAM::ScoreSketch sketch =
+            manager.MergeSketches(SAM::GpaRanking::kAllDepartments);
+    SAM::ScoreType median = sketch.Quantile(0.5);
+    double merge_seconds = Seconds(begin);
+
+    std::printf("%zu courses, %zu scores  median: sorted %7.2f ms (%.1f)  "
+                "merged sketches %7.2f ms (%.1f)\n",
+                course_num, scores.size(), sort_seconds * 1e3, exact_median,
+                merge_seconds * 1e3, median);
+}
+
+}  // namespace
+
+int main()
+{
+    for (std::size_t student_num : {1000, 5000, 20000})
+    {
+        for (double resolution : {0.1, 0.5, 2.0})
+            RunCourse(student_num, resolution);
+    }
+    RunUniversity(3000, 1000);
+    return 0;
+}
@@ -0,0 +1,84 @@
+// Compare DenseStore with std::map on the operations Manager uses most.
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <random>
+#include <vector>
+
+#include "../src/dense_store.h"
+#include "../src/student.h"
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+double Seconds(Clock::time_point begin)
+{
+    return std::chrono::duration<double>(Clock::now() - begin).count();
+}
+
+void Run(std::size_t n)
+{
+    using SAM::Student;
+    using SAM::StudentInfo;
+
+    std::vector<Student::IDType> ids(n);
+    for (std::size_t i = 0; i < n; i++)
+        ids[i] = 2010010000ULL + i * 7;  // roughly what THU IDs look like
+
+    std::mt19937_64 rng(n);
+    std::shuffle(ids.begin(), ids.end(), rng);
+
+    std::vector<Student::IDType> queries(ids);
+    std::shuffle(queries.begin(), queries.end(), rng);
+
+    StudentInfo info{0, "name", true, 14};
+    std::size_t found = 0;
+
+    // std::map
+    std::map<Student::IDType, Student> map;
+    auto begin = Clock::now();
+    for (auto id : ids)
+    {
+        info.id = id;
+        map.emplace(id, Student(info));
+    }
+    double map_insert = Seconds(begin);
+
+    begin = Clock::now();
+    for (auto id : queries)
+        found += map.count(id);
+    double map_lookup = Seconds(begin);
+
+    // DenseStore
+    SAM::DenseStore<Student::IDType, Student> store;
+    begin = Clock::now();
+    for (auto id : ids)
+    {
+        info.id = id;
+        store.Insert(id, Student(info));
+    }
+    store.begin();  // include the cost of building the sorted view
+    double store_insert = Seconds(begin);
+
+    begin = Clock::now();
+    for (auto id : queries)
+        found += store.Contains(id);
+    double store_lookup = Seconds(begin);
+
+    std::printf("%8zu students  insert: map %8.2f Mop/s  store %8.2f Mop/s"
+                "  lookup: map %8.2f Mop/s  store %8.2f Mop/s  (%zu)\n",
+                n,
+                n / map_insert / 1e6, n / store_insert / 1e6,
+                n / map_lookup / 1e6, n / store_lookup / 1e6,
+                found);
+}
+
+}  // namespace
+
+int main()
+{
+    for (std::size_t n : {10000, 100000, 1000000})
+        Run(n);
+    return 0;
+}
@@ -1,41 +1,28 @@
 // Designed to used in THU
-#include <limits>
+#include <cstdio>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
 #include <iomanip>
+#include <mutex>
+#include <sstream>
 #include "analyser.h"
+#include "atomic_file.h"
 
 namespace SAM {
 
-const char * CourseIDInfo::kSeasonStr[3] = {
-    "春", "夏", "秋"
-};
-
-// Assume IDType is std::string
-// and the format is yyyyS-xxxxxxxxx
-// where yyyy is the year, S is the season.
-CourseIDInfo::CourseIDInfo(const CourseInfo::IDType &course_id)
-{
-    std::size_t dash_position = course_id.find('-');
-
-    std::size_t year_end;
-    year = std::stoi(course_id, &year_end);
-    std::string season_str =
-            course_id.substr(year_end, dash_position - year_end);
+namespace {
 
-    if (season_str == kSeasonStr[0])
-        season = SPRING;
-    else if (season_str == kSeasonStr[1])
-        season = SUMMER;
-    else
-        season = FALL;
-    // no winter
+// what a worker takes at a time
+const std::size_t kStudentsPerChunk = 64;
 
-    id = std::stoi(course_id.substr(dash_position + 1));
-}
+}  // namespace
 
 CourseIDInfo::operator CourseInfo::IDType() const
 {
     CourseInfo::IDType course_id = std::to_string(year);
-    course_id += kSeasonStr[season];
+    course_id += kSeasonName[season];
     course_id += '-';
     course_id += std::to_string(id);
 
@@ -65,10 +52,17 @@ std::ostream & operator<<(std::ostream &os, const Transcript &transcript)
 
         os << std::left;
 
-        CourseIDInfo course_id_info(entry.course_info.id);
-        os << setw(8) << course_id_info.id << "  "
-           << setw(4) << course_id_info.year
-           << CourseIDInfo::kSeasonStr[course_id_info.season] << "  ";
+        if (entry.course_key != kNoCourseKey)
+        {
+            CourseIDInfo course_id_info(entry.course_key);
+            os << setw(8) << course_id_info.id << "  "
+               << setw(4) << course_id_info.year
+               << kSeasonName[course_id_info.season] << "  ";
+        }
+        else
+        {
+            PrintChinese(os, entry.course_info.id, 16) << "  ";
+        }
 
         PrintChinese(os, entry.course_info.name, 30) << "  "
 
@@ -107,81 +101,250 @@ bool Analyser::GenerateTranscript(const Manager &manager,
         return false;
 
     transcript.student_info = stu_iter->info();
-    ScoreType weighted_sum = 0;
+    double weighted_sum = 0;
     transcript.total_credit = 0;
+    std::size_t included = 0;
+
+    CourseList course_list = stu_iter->courses_taken();
+    std::vector<CourseHandle> courses_taken(course_list.begin(),
+                                            course_list.end());
+    manager.SortByCourseID(courses_taken);
 
-    for (Course::IDType course_id : stu_iter->courses_taken())
+    for (CourseHandle course_handle : courses_taken)
     {
         // building a transcript entry
         TranscriptEntry entry;
 
-        auto crs_iter = manager.FindCourse(course_id);
-        if (crs_iter == manager.course_end())
-        {
-            // internal failure in manager
-            std::exit(EXIT_FAILURE);
-        }
-
-        if (!course_filter(*crs_iter))
+        const Course &course = manager.course(course_handle);
+        if (!course_filter(course))
             continue;
 
-        entry.course_info = crs_iter->info();
-        entry.score = crs_iter->GetScore(student_id);
-        entry.student_num = crs_iter->StudentNumber();
-        SetMaxMinRank(crs_iter, entry);
+        entry.course_info = course.info();
+        entry.course_key = course.key();
+        entry.score = course.GetScore(student_id);
+        entry.student_num = course.StudentNumber();
+        SetMaxMinRank(course, entry);
 
         transcript.final_scores.push_back(entry);
+        included++;
 
-        // for credit and GPA
-        if (entry.score != kInvalidScore)
+        // for credit and GPA, NaN is not counted, as by the manager
+        if (entry.score != kInvalidScore && entry.score == entry.score)
         {
             int credit = entry.course_info.credit;
 
-            weighted_sum += entry.score * credit;
+            weighted_sum += double(entry.score) * credit;
             transcript.total_credit += credit;
         }
     }
 
-    if (transcript.total_credit != 0)
-        transcript.gpa = weighted_sum / transcript.total_credit;
+    if (included == courses_taken.size())  // the totals the manager keeps
+    {
+        transcript.total_credit = stu_iter->total_credit();
+        transcript.gpa = stu_iter->gpa();
+    }
+    else if (transcript.total_credit != 0)
+    {
+        transcript.gpa = static_cast<ScoreType>(weighted_sum /
+                                                transcript.total_credit);
+    }
     else
+    {
         transcript.gpa = kInvalidScore;
+    }
 
     return true;
 }
 
-void Analyser::SetMaxMinRank(const Manager::CourseIterator &crs_iter,
-                             TranscriptEntry &entry)
+// From the statistics the course keeps, so a transcript of every student
+// of a course scans its roster once, not once per student
+void Analyser::SetMaxMinRank(const Course &course, TranscriptEntry &entry)
+{
+    auto statistics = course.statistics();
+
+    entry.max_score = statistics->max_score();
+    entry.min_score = statistics->min_score();
+    entry.rank = statistics->Rank(entry.score);
+}
+
+TranscriptExporter::TranscriptExporter()
+        : transcript_num_(0),
+          seconds_(0)
 {
-    ScoreType min = std::numeric_limits<ScoreType>::max();
-    ScoreType max = std::numeric_limits<ScoreType>::lowest();
-    int rank_now = 1;
-    bool exist_valid_score = false;
+}
 
-    for (const ScorePiece &score_piece : crs_iter->final_score())
+std::vector<const Student *> TranscriptExporter::Prepare(
+        const Manager &manager,
+        const Manager::StudentFilter &filter)
+{
+    // in ID order already, as the manager iterates
+    std::vector<const Student *> students;
+    for (auto iter = manager.student_begin();
+         iter != manager.student_end();
+         ++iter)
     {
-        ScoreType score = score_piece.score;
+        if (filter(*iter))
+            students.push_back(&*iter);
+    }
+    // from now on the workers only read them
+    for (auto iter = manager.course_begin();
+         iter != manager.course_end();
+         ++iter)
+        iter->statistics();
+
+    transcript_num_ = students.size();
+    return students;
+}
 
-        if (score == kInvalidScore)  // ignore invalid scores
-            continue;
+bool TranscriptExporter::WriteFile(const Manager &manager,
+                                   const Manager::StudentFilter &filter,
+                                   const std::string &file_name)
+{
+    Clock::time_point start = Clock::now();
+    std::vector<const Student *> students = Prepare(manager, filter);
 
-        exist_valid_score = true;
+    AtomicFile fout(true);
+    if (!fout.Open(file_name))
+        return false;
 
-        if (score < min)
-            min = score;
-        if (score > max)
-            max = score;
+    // Workers format chunks of students, this thread writes them in order.
+    // Workers stay within window chunks of the writer, to bound memory.
+    std::size_t chunk_num = (students.size() + kStudentsPerChunk - 1) /
+                            kStudentsPerChunk;
+    std::size_t window = thread_num_ * 4;
+    std::vector<std::string> outputs(chunk_num);
+    std::vector<bool> ready(chunk_num, false);
+    std::size_t next_chunk = 0, written = 0;
+    std::mutex mutex;
+    std::condition_variable changed;
+
+    auto work = [&]()
+    {
+        Analyser analyser;
+        std::ostringstream oss;
+        while (true)
+        {
+            std::size_t chunk;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                changed.wait(lock, [&]()
+                             {
+                                 return next_chunk == chunk_num ||
+                                        next_chunk < written + window;
+                             });
+                if (next_chunk == chunk_num)
+                    return;
+                chunk = next_chunk++;
+            }
+
+            oss.str(std::string());
+            std::size_t end = std::min(students.size(),
+                                       (chunk + 1) * kStudentsPerChunk);
+            for (std::size_t index = chunk * kStudentsPerChunk;
+                 index < end; index++)
+            {
+                Transcript transcript;
+                analyser.GenerateTranscript(manager,
+                                            students[index]->info().id,
+                                            transcript);
+                oss << transcript << '\n';
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                outputs[chunk] = oss.str();
+                ready[chunk] = true;
+            }
+            changed.notify_all();
+        }
+    };
 
-        if (score > entry.score)
-            rank_now++;
-    }
+    auto write = [&]()
+    {
+        std::string text;
+        for (std::size_t chunk = 0; chunk < chunk_num; chunk++)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                changed.wait(lock, [&]() { return ready[chunk]; });
+                text.swap(outputs[chunk]);
+                written++;
+            }
+            changed.notify_all();
+
+            fout.Append(text.data(), text.size());
+            fout.MaybeFlush();
+            std::string().swap(text);
+        }
+    };
+
+    // thread_num_ workers besides the writer
+    RunOnThreads(thread_num_ + 1, [&](unsigned index)
+    {
+        if (index == 0)
+            write();
+        else
+            work();
+    });
+
+    bool committed = fout.Commit();
+    seconds_ = SecondsSince(start);
+    return committed;
+}
+
+bool TranscriptExporter::WriteFiles(const Manager &manager,
+                                    const Manager::StudentFilter &filter,
+                                    const std::string &directory)
+{
+    Clock::time_point start = Clock::now();
+    std::vector<const Student *> students = Prepare(manager, filter);
+
+    std::atomic<std::size_t> next_student(0);
+    std::atomic<bool> failed(false);
+
+    // Files are independent, so each worker writes its own. They are plain
+    // files: a transcript can always be generated again.
+    auto work = [&]()
+    {
+        Analyser analyser;
+        std::ostringstream oss;
+        for (std::size_t begin = next_student.fetch_add(kStudentsPerChunk);
+             begin < students.size();
+             begin = next_student.fetch_add(kStudentsPerChunk))
+        {
+            std::size_t end = std::min(students.size(),
+                                       begin + kStudentsPerChunk);
+            for (std::size_t index = begin; index < end; index++)
+            {
+                Transcript transcript;
+                StudentInfo::IDType id = students[index]->info().id;
+                analyser.GenerateTranscript(manager, id, transcript);
+
+                oss.str(std::string());
+                oss << transcript;
+                const std::string &text = oss.str();
+
+                std::string file_name = directory + '/' +
+                                        std::to_string(id) + ".txt";
+                std::FILE *file = std::fopen(file_name.c_str(), "wb");
+                if (file == nullptr)
+                {
+                    failed = true;
+                    continue;
+                }
+                if (std::fwrite(text.data(), 1, text.size(), file) !=
+                    text.size())
+                    failed = true;
+                if (std::fclose(file) != 0)
+                    failed = true;
+            }
+        }
+    };
 
-    if (!exist_valid_score)
-        max = min = kInvalidScore;
+    RunOnThreads(thread_num_, [&work](unsigned) { work(); });
 
-    entry.max_score = max;
-    entry.min_score = min;
-    entry.rank = (entry.score == kInvalidScore ? 0 : rank_now);
+    seconds_ = SecondsSince(start);
+    return !failed;
 }
 
 
@@ -3,23 +3,29 @@
 #ifndef SAM_ANALYSER_H_
 #define SAM_ANALYSER_H_
 
+#include <cstddef>
+
 #include <functional>
 #include <ostream>
+#include <string>
 #include <vector>
 #include "common.h"
 #include "manager.h"
+#include "parallel.h"
 
 namespace SAM {
 
+// The parts of a course key (see Course::key())
 struct CourseIDInfo
 {
     CourseIDInfo() = default;
-    explicit CourseIDInfo(const CourseInfo::IDType &course_id);
+    // The key shall not be kNoCourseKey
+    explicit CourseIDInfo(CourseKey key)
+            : id(static_cast<int>(CourseKeyNumber(key))),
+              year(CourseKeyYear(key)),
+              season(CourseKeySeason(key)) {}
     explicit operator CourseInfo::IDType() const;
 
-    enum Season { SPRING, SUMMER, FALL };
-    static const char * kSeasonStr[3];
-
     int id;
     int year;
     Season season;
@@ -28,6 +34,7 @@ struct CourseIDInfo
 struct TranscriptEntry
 {
     CourseInfo course_info;
+    CourseKey course_key;
 
     ScoreType score;
     ScoreType min_score;
@@ -69,9 +76,48 @@ class Analyser
                             CourseFilter course_filter,
                             Transcript &transcript);
 
+    // Courses with keys in [begin, end), as given by ParseSemester()
+    static CourseFilter SemesterFilter(CourseKey begin, CourseKey end)
+    {
+        return [begin, end](const Course &course)
+               { return course.key() >= begin && course.key() < end; };
+    }
+
+ private:
+    void SetMaxMinRank(const Course &course, TranscriptEntry &entry);
+};
+
+// Transcripts of many students at once, printed as operator<< does, in
+// student ID order. They are generated on up to thread_num() threads (the
+// number of cores by default), which share the statistics of the courses,
+// worked out once before they start.
+class TranscriptExporter : public ThreadCount
+{
+ public:
+    TranscriptExporter();
+
+    // All of them into one file, which is replaced only once complete
+    bool WriteFile(const Manager &manager,
+                   const Manager::StudentFilter &filter,
+                   const std::string &file_name);
+    // One file for each student, <directory>/<student ID>.txt. Return false
+    // if any of them cannot be written.
+    bool WriteFiles(const Manager &manager,
+                    const Manager::StudentFilter &filter,
+                    const std::string &directory);
+
+    // by the last Write*
+    std::size_t transcript_num() const { return transcript_num_; }
+    double seconds() const { return seconds_; }
+    double throughput() const  // transcripts per second
+    { return seconds_ > 0 ? transcript_num_ / seconds_ : 0; }
+
  private:
-    void SetMaxMinRank(const Manager::CourseIterator &crs_iter,
-                       TranscriptEntry &entry);
+    std::vector<const Student *> Prepare(const Manager &manager,
+                                         const Manager::StudentFilter &filter);
+
+    std::size_t transcript_num_;
+    double seconds_;
 };
 
 }  // namespace SAM
@@ -0,0 +1,180 @@
+#if !defined(_WIN32) && (defined(__unix__) || defined(__unix) || (defined(__APPLE__) && defined(__MACH__)))
+
+#ifndef UNIX_LIKE_SYS
+#define UNIX_LIKE_SYS
+#endif
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#endif
+
+#include "atomic_file.h"
+
+namespace SAM {
+
+const std::size_t AtomicFile::kBlockSize;
+
+namespace {
+
+// Make a rename in the directory of file_name durable
+void SyncDirectoryOf(const std::string &file_name)
+{
+#ifdef UNIX_LIKE_SYS
+    std::size_t slash = file_name.rfind('/');
+    std::string directory = (slash == std::string::npos ?
+                             "." : file_name.substr(0, slash + 1));
+
+    int fd = ::open(directory.c_str(), O_RDONLY);
+    if (fd >= 0)
+    {
+        ::fsync(fd);
+        ::close(fd);
+    }
+#else
+    (void)file_name;
+#endif
+}
+
+}  // namespace
+
+AtomicFile::AtomicFile(bool background)
+        : file_name_(), temp_name_(), file_(nullptr), failed_(false),
+          buffer_(), background_(background), writer_(), mutex_(),
+          changed_(), blocks_(), closing_(false)
+{
+}
+
+AtomicFile::~AtomicFile()
+{
+    Discard();
+}
+
+bool AtomicFile::Open(const std::string &file_name)
+{
+    Discard();
+
+    file_name_ = file_name;
+    temp_name_ = file_name + ".tmp";
+    file_ = std::fopen(temp_name_.c_str(), "wb");
+    if (!file_)
+        return false;
+
+    std::setvbuf(file_, nullptr, _IONBF, 0);  // buffered here instead
+    failed_ = false;
+    buffer_.reserve(kBlockSize + kBlockSize / 4);
+
+    if (background_)
+    {
+        closing_ = false;
+        writer_ = std::thread(&AtomicFile::WriterLoop, this);
+    }
+    return true;
+}
+
+bool AtomicFile::Commit()
+{
+    if (!file_)
+        return false;
+
+    Flush();
+    StopWriter();
+
+    bool ok = !failed_ && std::fflush(file_) == 0;
+#ifdef UNIX_LIKE_SYS
+    ok = ok && ::fsync(::fileno(file_)) == 0;
+#endif
+    ok = (std::fclose(file_) == 0) && ok;
+    file_ = nullptr;
+
+#ifndef UNIX_LIKE_SYS
+    // rename() does not replace an existing file everywhere
+    if (ok)
+        std::remove(file_name_.c_str());
+#endif
+    ok = ok && std::rename(temp_name_.c_str(), file_name_.c_str()) == 0;
+
+    if (ok)
+        SyncDirectoryOf(file_name_);
+    else
+        std::remove(temp_name_.c_str());
+    return ok;
+}
+
+void AtomicFile::Discard()
+{
+    if (!file_)
+        return;
+
+    StopWriter();  // at most two blocks are left
+
+    std::fclose(file_);
+    file_ = nullptr;
+    std::remove(temp_name_.c_str());
+    buffer_.clear();
+}
+
+void AtomicFile::Flush()
+{
+    if (buffer_.empty())
+        return;
+
+    if (!background_)
+    {
+        failed_ = !WriteBlock(buffer_) || failed_;
+        buffer_.clear();
+        return;
+    }
+
+    std::string block;
+    block.reserve(kBlockSize + kBlockSize / 4);
+    block.swap(buffer_);
+    {
+        // Two blocks in flight are enough to keep the disk busy
+        std::unique_lock<std::mutex> lock(mutex_);
+        changed_.wait(lock, [this] { return blocks_.size() < 2; });
+        blocks_.push_back(std::move(block));
+    }
+    changed_.notify_all();
+}
+
+bool AtomicFile::WriteBlock(const std::string &block)
+{
+    return std::fwrite(block.data(), 1, block.size(), file_) == block.size();
+}
+
+void AtomicFile::WriterLoop()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true)
+    {
+        changed_.wait(lock, [this] { return !blocks_.empty() || closing_; });
+        if (blocks_.empty())
+            return;  // closing, and everything is written
+
+        std::string &block = blocks_.front();
+        lock.unlock();
+        bool ok = WriteBlock(block);
+        lock.lock();
+
+        if (!ok)
+            failed_ = true;
+        blocks_.pop_front();
+        changed_.notify_all();
+    }
+}
+
+void AtomicFile::StopWriter()
+{
+    if (!writer_.joinable())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closing_ = true;
+    }
+    changed_.notify_all();
+    writer_.join();
+}
+
+}  // namespace SAM
@@ -0,0 +1,75 @@
+#ifndef SAM_ATOMIC_FILE_H_
+#define SAM_ATOMIC_FILE_H_
+
+#include <cstddef>
+#include <cstdio>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace SAM {
+
+// Write a file through large buffers, and replace the target atomically:
+// the data go to a temporary file next to it, which Commit() flushes to
+// disk (fsync) and renames over the target. Until then the old file is
+// untouched, and if Commit() is never reached the temporary file is
+// removed, so a crash in the middle of saving loses nothing.
+//
+// With background set, full buffers are written by another thread, so
+// formatting the next buffer overlaps with writing the last one.
+class AtomicFile
+{
+ public:
+    explicit AtomicFile(bool background = false);
+    ~AtomicFile();  // discards the data unless committed
+    AtomicFile(const AtomicFile &) = delete;
+    AtomicFile & operator=(const AtomicFile &) = delete;
+
+    // Return false if the temporary file cannot be created
+    bool Open(const std::string &file_name);
+
+    // Format into this, then call MaybeFlush() from time to time
+    std::string & buffer() { return buffer_; }
+    void Append(const char *data, std::size_t size)
+    { buffer_.append(data, size); }
+
+    // Hand the buffer over to be written once it is large enough
+    void MaybeFlush()
+    {
+        if (buffer_.size() >= kBlockSize)
+            Flush();
+    }
+
+    // Return false (and keep the old file) if anything failed
+    bool Commit();
+    void Discard();
+
+ private:
+    static const std::size_t kBlockSize = 1 << 20;
+
+    void Flush();
+    bool WriteBlock(const std::string &block);
+    void WriterLoop();
+    void StopWriter();
+
+    std::string file_name_;
+    std::string temp_name_;
+    std::FILE *file_;
+    bool failed_;
+    std::string buffer_;
+
+    // background writing
+    bool background_;
+    std::thread writer_;
+    std::mutex mutex_;
+    std::condition_variable changed_;
+    std::deque<std::string> blocks_;  // waiting to be written
+    bool closing_;
+};
+
+}  // namespace SAM
+
+#endif  // SAM_ATOMIC_FILE_H_
@@ -1,4 +1,6 @@
 #include <cctype>
+#include <cstdint>
+#include <cstdio>
 #include <cstdlib>
 #include <cstring>
 
@@ -20,9 +22,22 @@
 #include "analyser.h"
 #include "command_line_interface.h"
 #include "io.h"
+#include "mutation_log.h"
+#include "report.h"
+#include "segmented_snapshot.h"
+#include "snapshot.h"
 
 namespace {
 
+bool FileExists(const char *file_name)
+{
+    std::FILE *file = std::fopen(file_name, "rb");
+    if (file == nullptr)
+        return false;
+    std::fclose(file);
+    return true;
+}
+
 void StriptWhite(std::string &str)
 {
     std::size_t begin = str.find_first_not_of(" \t");
@@ -47,11 +62,15 @@ char * CommandGenerator(const char *text, int state);
 #endif
 
 static const int kScoreWidth = 5;
+static const char *kManifestFileName = "sam.manifest";
+static const char *kSnapshotFileName = "sam.snapshot";  // before segments
+static const char *kLogFileName = "sam.log";
 
 std::vector<CommandLineInterface::Command> CommandLineInterface::commands_ = {
     {"ls-stu", &CommandLineInterface::ListStudents},
     {"add-stu", &CommandLineInterface::AddStudent},
     {"rm-stu", &CommandLineInterface::RemoveStudent},
+    {"rm-cohort", &CommandLineInterface::RemoveCohort},
     {"stu", &CommandLineInterface::ShowStudent},
 
     {"ls-crs", &CommandLineInterface::ListCourses},
@@ -60,13 +79,25 @@ std::vector<CommandLineInterface::Command> CommandLineInterface::commands_ = {
     {"crs", &CommandLineInterface::ShowCourse},
 
     {"reg", &CommandLineInterface::RegisterToCourse},
+    {"reg-many", &CommandLineInterface::RegisterManyToCourse},
     {"drop", &CommandLineInterface::DropFromCourse},
 
     {"record-final", &CommandLineInterface::RecordFinalScore},
+    {"import-final", &CommandLineInterface::ImportFinalScores},
     {"remove-final", &CommandLineInterface::RemoveFinalScore},
     {"ch-score", &CommandLineInterface::ChangeScore},
 
     {"gen-stu", &CommandLineInterface::GenerateTranscript},
+    {"gen-all", &CommandLineInterface::GenerateAllTranscripts},
+
+    {"top", &CommandLineInterface::ShowTopStudents},
+    {"rank", &CommandLineInterface::ShowRank},
+    {"gpa-cut", &CommandLineInterface::ShowGpaCutoff},
+    {"report", &CommandLineInterface::WriteReport},
+    {"pct", &CommandLineInterface::ShowPercentile},
+
+    {"batch", &CommandLineInterface::ApplyBatch},
+    {"renumber", &CommandLineInterface::RenumberStudents},
 
     {"save", &CommandLineInterface::Save},
     {"load", &CommandLineInterface::Load}
@@ -77,6 +108,9 @@ CommandLineInterface::CommandLineInterface()
         : prompt_("SAM-1.0: "),
           command_stream_(),
           manager_(),
+          log_(),
+          snapshot_(kManifestFileName),
+          load_failed_(false),
           interactive_mode(true)
 {
 }
@@ -146,6 +180,7 @@ int CommandLineInterface::Run(int argc, const char* const argv[])
                             case 7: GenerateTranscript(); break;
                             case 8: ChangeScore(); break;
                         }
+                        CommitLog();
                     }
                     break;
                 }
@@ -173,6 +208,7 @@ int CommandLineInterface::Run(int argc, const char* const argv[])
                             case 5: RecordFinalScore(); break;
                             case 6: RemoveFinalScore(); break;
                         }
+                        CommitLog();
                     }
                     break;
                 }
@@ -200,6 +236,7 @@ bool CommandLineInterface::ParseAndRunCommand()
         {
             std::cout << std::endl;
             legal_command.second(*this);
+            CommitLog();
             std::cout << std::endl;
             return false;
         }
@@ -246,7 +283,14 @@ void CommandLineInterface::AddStudent()
               << Student(info) << std::endl;
 
     std::string prompt("确定要添加该学生吗? (y/n): ");
-    if (GetYesNoChoice(prompt) && !manager_.AddStudent(info))
+    if (!GetYesNoChoice(prompt))
+        return;
+
+    if (manager_.AddStudent(info))
+    {
+        log_.AddStudent(info);
+    }
+    else
     {
         std::cout << "无法添加新学生: ID " << info.id
                   << " 已经被占用\n";
@@ -261,10 +305,50 @@ void CommandLineInterface::RemoveStudent()
         return;
 
     std::string prompt("确定要移除学生 " + ShortStudentInfo(id) + " 吗? (y/n): ");
-    if (GetYesNoChoice(prompt) && !manager_.RemoveStudent(id))
+    if (!GetYesNoChoice(prompt))
+        return;
+
+    if (manager_.RemoveStudent(id))
+        log_.RemoveStudent(id);
+    else
         std::cerr << "Internal Error\n";
 }
 
+void CommandLineInterface::RemoveCohort()
+{
+    if (interactive_mode)
+    {
+        if (!ReadLineIntoStream("请输入要移除的学号范围 (起始学号 结束学号): "))
+            return;
+    }
+
+    StudentInfo::IDType first, last;
+    if (!(command_stream_ >> first >> last) || first > last)
+    {
+        std::cout << "无效的学号范围\n";
+        return;
+    }
+
+    std::string prompt("确定要移除学号在 " + std::to_string(first) + " 到 " +
+                       std::to_string(last) + " 之间的所有学生吗? (y/n): ");
+    if (!GetYesNoChoice(prompt))
+        return;
+
+    RemovalSummary summary;
+    manager_.RemoveStudents([first, last](const Student &student)
+                            {
+                                return student.info().id >= first &&
+                                       student.info().id <= last;
+                            },
+                            summary);
+    if (!summary.removed_ids.empty())
+        log_.RemoveCohort(first, last);
+
+    std::cout << "已移除 " << summary.removed_ids.size() << " 名学生, "
+              << "涉及 " << summary.course_num << " 门课程的 "
+              << summary.enrollment_num << " 条选课记录\n";
+}
+
 void CommandLineInterface::ShowStudent() const
 {
     using std::cout;
@@ -287,23 +371,25 @@ void CommandLineInterface::ShowStudent() const
              << std::string(Course::HeadingSize() + 1 + kScoreWidth, '-')
              << std::endl;
 
-        for (const Course::IDType &course_id : stu_iter->courses_taken())
-        {
-            auto crs_iter = manager_.FindCourse(course_id);
-            if (crs_iter == manager_.course_end())
-            {
-                std::cerr << "Internal Error\n";
-                return;
-            }
+        CourseList course_list = stu_iter->courses_taken();
+        std::vector<CourseHandle> courses_taken(course_list.begin(),
+                                                course_list.end());
+        manager_.SortByCourseID(courses_taken);
 
-            cout << *crs_iter << ' ';
+        for (CourseHandle course_handle : courses_taken)
+        {
+            const Course &course = manager_.course(course_handle);
+            cout << course << ' ';
 
             // add score info to the end
             cout.width(kScoreWidth);
-            PrintScore(cout, crs_iter->GetScore(id));
+            PrintScore(cout, course.GetScore(id));
 
             cout << std::endl;
         }
+
+        cout << "\n总学分: " << stu_iter->total_credit() << "  GPA: ";
+        PrintScore(cout, stu_iter->gpa()) << std::endl;
     }
     else
     {
@@ -312,11 +398,30 @@ void CommandLineInterface::ShowStudent() const
     }
 }
 
+// ls-crs [semester], a semester is like 2014秋, or 2014 for a whole year
 void CommandLineInterface::ListCourses() const
 {
+    std::string semester;
+    CourseKey begin, end;
+    if (!interactive_mode && command_stream_ >> semester &&
+        !ParseSemester(semester, begin, end))
+    {
+        std::cout << semester << ": 无效的学期\n";
+        return;
+    }
+
     std::cout << Course::Heading() << std::endl
               << std::string(Course::HeadingSize(), '-') << std::endl;
 
+    if (!semester.empty())  // from the semester index
+    {
+        std::vector<CourseHandle> handles;
+        manager_.FindCourses(begin, end, handles);
+        for (CourseHandle handle : handles)
+            std::cout << manager_.course(handle) << std::endl;
+        return;
+    }
+
     for (auto iter = manager_.course_begin(); iter != manager_.course_end();
          ++iter)
     {
@@ -348,10 +453,13 @@ void CommandLineInterface::AddCourse()
               << Course(info) << std::endl;
 
     std::string prompt("确定要添加该课程吗? (y/n): ");
-    if (GetYesNoChoice(prompt) && !manager_.AddCourse(info))
-    {
+    if (!GetYesNoChoice(prompt))
+        return;
+
+    if (manager_.AddCourse(info))
+        log_.AddCourse(info);
+    else
         std::cout << "无法添加新课程: ID " << info.id << " 已经被占用\n";
-    }
 }
 
 void CommandLineInterface::RemoveCourse()
@@ -362,7 +470,12 @@ void CommandLineInterface::RemoveCourse()
         return;
 
     std::string prompt("确定要移除课程 " + ShortCourseInfo(id) + " 吗? (y/n): ");
-    if (GetYesNoChoice(prompt) && !manager_.RemoveCourse(id))
+    if (!GetYesNoChoice(prompt))
+        return;
+
+    if (manager_.RemoveCourse(id))
+        log_.RemoveCourse(id);
+    else
         std::cerr << "Internal Error\n";
 }
 
@@ -420,7 +533,14 @@ void CommandLineInterface::RegisterToCourse()
 
     std::string prompt("确定要将 " + ShortStudentInfo(student_id) + " 注册到 " +
                        ShortCourseInfo(course_id) + " 中吗? (y/n): ");
-    if (GetYesNoChoice(prompt) && !manager_.AddStudentToCourse(student_id, course_id))
+    if (!GetYesNoChoice(prompt))
+        return;
+
+    if (manager_.AddStudentToCourse(student_id, course_id))
+    {
+        log_.AddStudentToCourse(student_id, course_id);
+    }
+    else
     {
         std::cout << "无法将ID为 " << student_id << " 的学生注册到ID为 "
                   << course_id << " 的课程中\n"
@@ -428,6 +548,65 @@ void CommandLineInterface::RegisterToCourse()
     }
 }
 
+// reg-many <course ID> <file of student IDs>
+void CommandLineInterface::RegisterManyToCourse()
+{
+    Course::IDType course_id;
+    if (!GetCourseID("请输入要注册的课程的ID: ", course_id, true))
+        return;
+
+    if (interactive_mode)
+    {
+        if (!ReadLineIntoStream("请输入学号清单的文件名: "))
+            return;
+    }
+
+    std::string filename;
+    if (!(command_stream_ >> filename))
+    {
+        std::cout << "无效的文件名\n";
+        return;
+    }
+
+    std::vector<Student::IDType> student_ids;
+    ManagerReader reader;
+    std::size_t bad_line;
+
+    if (!reader.ReadStudentIDs(filename, student_ids, bad_line))
+    {
+        if (bad_line == 0)
+            std::cout << "无法打开文件 " << filename << '\n';
+        else
+            std::cout << "格式错误 (" << reader.error().ToString()
+                      << "), 未做任何修改\n";
+        return;
+    }
+
+    std::vector<EnrollOutcome> outcomes;
+    manager_.AddStudentToCourse(student_ids, course_id, outcomes);
+
+    // by EnrollOutcome::Status
+    static const char *kStatusNames[] = {
+        "已注册", "已在课程中", "不存在该学生", "课程人数已满"
+    };
+    std::vector<Student::IDType> lists[4];
+    for (const EnrollOutcome &outcome : outcomes)
+    {
+        lists[outcome.status].push_back(outcome.id);
+        if (outcome.status == EnrollOutcome::ADDED)
+            log_.AddStudentToCourse(outcome.id, course_id);
+    }
+
+    for (int status = 0; status < 4; status++)
+    {
+        std::cout << kStatusNames[status] << " (" << lists[status].size()
+                  << "):";
+        for (Student::IDType id : lists[status])
+            std::cout << ' ' << id;
+        std::cout << '\n';
+    }
+}
+
 void CommandLineInterface::DropFromCourse()
 {
     Student::IDType student_id;
@@ -439,8 +618,14 @@ void CommandLineInterface::DropFromCourse()
 
     std::string prompt("确定要将 " + ShortStudentInfo(student_id) + " 从 " +
                        ShortCourseInfo(course_id) + " 退课吗? (y/n): ");
-    if (GetYesNoChoice(prompt) &&
-        !manager_.RemoveStudentFromCourse(student_id, course_id))
+    if (!GetYesNoChoice(prompt))
+        return;
+
+    if (manager_.RemoveStudentFromCourse(student_id, course_id))
+    {
+        log_.RemoveStudentFromCourse(student_id, course_id);
+    }
+    else
     {
         std::cout << "无法将ID为 " << student_id << " 的学生从ID为 "
                   << course_id << "的课程中退课\n"
@@ -462,12 +647,23 @@ void CommandLineInterface::RecordFinalScore()
     std::string filename = command_stream_.str();
 
     // read from file
-    std::vector<Student::IDType> unscored_students;
+    std::vector<Student::IDType> unscored_students, not_enrolled;
     ManagerReader reader;
     if (!reader.ReadFinalScore(filename, manager_, course_id,
-                               unscored_students) && !filename.empty())
+                               unscored_students, not_enrolled) &&
+        !filename.empty())
     {
-        std::cout << "无法从文件 " << filename << " 中读取考试成绩\n";
+        std::cout << "无法从文件 " << filename << " 中读取考试成绩";
+        if (reader.error().line != 0)
+            std::cout << " (" << reader.error().ToString() << ')';
+        std::cout << '\n';
+    }
+    if (!not_enrolled.empty())
+    {
+        std::cout << "以下学生未选该课程, 其成绩被忽略:";
+        for (Student::IDType student_id : not_enrolled)
+            std::cout << ' ' << student_id;
+        std::cout << '\n';
     }
 
     // record score for unscored_students
@@ -477,7 +673,7 @@ void CommandLineInterface::RecordFinalScore()
         std::string prompt = "请输入" + ShortStudentInfo(student_id) + "的成绩: ";
         if (!ReadLineIntoStream(prompt.c_str()))  // EOF
         {
-            return;  // stop inputing right now
+            break;  // stop inputing right now
         }
         else if (command_stream_ >> score)
         {
@@ -485,6 +681,91 @@ void CommandLineInterface::RecordFinalScore()
         }
         // else cannot read a score, skip this student
     }
+
+    // The file may have changed any score of the course, log them all
+    if (log_.is_open())
+    {
+        for (const ScorePiece &score_piece :
+                 manager_.FindCourse(course_id)->final_score())
+            log_.ChangeScore(score_piece.id, course_id, score_piece.score);
+    }
+}
+
+// Final scores of many courses at once, from a manifest or a directory.
+// Unscored students are only reported, there may be hundreds of courses.
+void CommandLineInterface::ImportFinalScores()
+{
+    if (interactive_mode)
+    {
+        if (!ReadLineIntoStream("请输入成绩清单或目录的名称: "))
+            return;
+    }
+
+    std::string path;
+    if (!(command_stream_ >> path))
+    {
+        std::cout << "无效的文件名\n";
+        return;
+    }
+
+    std::vector<FinalScoreFile> files;
+    ManagerReader reader;
+    if (!reader.ReadFinalScores(path, manager_, files))
+    {
+        std::cout << "无法从 " << path << " 中读取成绩清单";
+        if (reader.error().line != 0)
+            std::cout << " (" << reader.error().ToString() << ')';
+        std::cout << ", 未做任何修改\n";
+        return;
+    }
+
+    std::size_t recorded_num = 0;
+    for (const FinalScoreFile &file : files)
+    {
+        if (!file.recorded)
+        {
+            std::cout << file.course_id << ": ";
+            if (!manager_.HasCourse(file.course_id))
+                std::cout << "没有该课程";
+            else
+                std::cout << "无法从文件 " << file.file_name << " 中读取考试成绩";
+            if (file.error.line != 0)
+                std::cout << " (" << file.error.ToString() << ')';
+            std::cout << '\n';
+            continue;
+        }
+
+        recorded_num++;
+        if (log_.is_open())
+        {
+            for (const ScorePiece &score_piece :
+                     manager_.FindCourse(file.course_id)->final_score())
+                log_.ChangeScore(score_piece.id, file.course_id,
+                                 score_piece.score);
+        }
+
+        if (file.unscored_students.empty() && file.not_enrolled.empty())
+            continue;
+
+        std::cout << ShortCourseInfo(file.course_id) << ":\n";
+        if (!file.unscored_students.empty())
+        {
+            std::cout << "    没有成绩的学生:";
+            for (Student::IDType student_id : file.unscored_students)
+                std::cout << ' ' << student_id;
+            std::cout << '\n';
+        }
+        if (!file.not_enrolled.empty())
+        {
+            std::cout << "    未选该课程, 成绩被忽略:";
+            for (Student::IDType student_id : file.not_enrolled)
+                std::cout << ' ' << student_id;
+            std::cout << '\n';
+        }
+    }
+
+    std::cout << "已录入 " << recorded_num << " 门课程的成绩, "
+              << files.size() - recorded_num << " 门失败\n";
 }
 
 void CommandLineInterface::RemoveFinalScore()
@@ -497,7 +778,10 @@ void CommandLineInterface::RemoveFinalScore()
     std::string prompt = "确定要移除 " + ShortCourseInfo(course_id) +
                          " 的期末成绩吗 (y/n): ";
     if (GetYesNoChoice(prompt))
+    {
         manager_.RemoveFinalScore(course_id);
+        log_.RemoveFinalScore(course_id);
+    }
 }
 
 void CommandLineInterface::ChangeScore()
@@ -523,25 +807,43 @@ void CommandLineInterface::ChangeScore()
     if (command_stream_ >> score)
     {
         if (manager_.ChangeScore(student_id, course_id, score))
+        {
+            log_.ChangeScore(student_id, course_id, score);
             std::cout << "修改成功\n";
+        }
         else
             std::cerr << "Internal Error\n";
     }
 }
 
 
+// gen-stu <student ID> [semester], for the courses of a semester or year
 void CommandLineInterface::GenerateTranscript() const
 {
     Student::IDType student_id;
 
-    if (!GetStudentID("请输入要生成成绩单的学生的ID: ", student_id, true))
+    if (!GetStudentID("请输入要生成成绩单的学生的ID (其后可给出学期): ",
+                      student_id, true))
         return;
 
+    Analyser::CourseFilter filter = [](const Course &) { return true; };
+    std::string semester;
+    if (command_stream_ >> semester)
+    {
+        CourseKey begin, end;
+        if (!ParseSemester(semester, begin, end))
+        {
+            std::cout << semester << ": 无效的学期\n";
+            return;
+        }
+        filter = Analyser::SemesterFilter(begin, end);
+    }
 
     Transcript transcript;
     Analyser analyser;
 
-    if (!analyser.GenerateTranscript(manager_, student_id, transcript))
+    if (!analyser.GenerateTranscript(manager_, student_id, filter,
+                                     transcript))
     {
         std::cout << "Failed to generate transcript\n";
     }
@@ -551,21 +853,469 @@ void CommandLineInterface::GenerateTranscript() const
     }
 }
 
+// gen-all <file> [department], or <directory>/ for a file per student
+void CommandLineInterface::GenerateAllTranscripts() const
+{
+    if (interactive_mode)
+    {
+        if (!ReadLineIntoStream("请输入成绩单的输出文件, 或以 / 结尾的目录"
+                                " (其后可给出院系编号): "))
+            return;
+    }
+
+    std::string path;
+    if (!(command_stream_ >> path))
+    {
+        std::cout << "无效的文件名\n";
+        return;
+    }
+
+    Manager::StudentFilter filter = [](const Student &) { return true; };
+    int department;
+    if (command_stream_ >> department)
+    {
+        filter = [department](const Student &student)
+                 {
+                     return student.info().department == department;
+                 };
+    }
+
+    TranscriptExporter exporter;
+    bool written;
+    if (path.back() == '/')
+    {
+        path.pop_back();
+        written = exporter.WriteFiles(manager_, filter,
+                                      path.empty() ? "/" : path);
+    }
+    else
+    {
+        written = exporter.WriteFile(manager_, filter, path);
+    }
+
+    if (!written)
+        std::cout << "无法写入 " << path << '\n';
+    std::cout << "已生成 " << exporter.transcript_num() << " 份成绩单, 用时 "
+              << exporter.seconds() << " 秒 ("
+              << static_cast<long long>(exporter.throughput())
+              << " 份/秒)\n";
+}
+
+// top <k> [department]
+void CommandLineInterface::ShowTopStudents()
+{
+    if (interactive_mode)
+    {
+        if (!ReadLineIntoStream("请输入要列出的人数 (其后可给出院系编号): "))
+            return;
+    }
+
+    std::size_t k;
+    if (!(command_stream_ >> k))
+    {
+        std::cout << "无效的人数\n";
+        return;
+    }
+    int department = GpaRanking::kAllDepartments;
+    if (command_stream_ >> department &&
+        (department < 0 || department >= kDepartmentNum))
+    {
+        std::cout << "无效的院系编号\n";
+        return;
+    }
+
+    const GpaRanking &ranking = manager_.Ranking();
+    std::vector<GpaRanking::Entry> entries;
+    ranking.Top(k, department, entries);
+
+    std::cout << "共 " << ranking.size(department) << " 名学生有GPA\n"
+              << "排名" << ' '
+              << Student::Heading() << ' '
+              << std::setw(kScoreWidth) << "GPA" << std::endl
+              << std::string(4 + 1 + Student::HeadingSize() + 1 + kScoreWidth,
+                             '-')
+              << std::endl;
+    for (const GpaRanking::Entry &entry : entries)
+    {
+        std::cout << std::setw(4) << entry.rank << ' '
+                  << *manager_.FindStudent(entry.id) << ' ';
+        std::cout.width(kScoreWidth);
+        PrintScore(std::cout, entry.gpa) << std::endl;
+    }
+}
+
+// rank <student ID>, in the university and in the department
+void CommandLineInterface::ShowRank()
+{
+    StudentInfo::IDType id;
+    if (!GetStudentID("请输入要查询排名的学生的ID: ", id, true))
+        return;
+
+    const GpaRanking &ranking = manager_.Ranking();
+    auto student = manager_.FindStudent(id);
+    GpaRanking::Entry entry;
+    if (!ranking.Find(student.handle(), false, entry))
+    {
+        std::cout << "该学生还没有GPA\n";
+        return;
+    }
+
+    int department = student->info().department;
+    std::cout << "GPA: " << entry.gpa << "\n"
+              << "全校排名: " << entry.rank << '/' << ranking.size()
+              << " (高于 " << ranking.Percentile(student.handle(), false)
+              << "% 的学生)\n";
+    ranking.Find(student.handle(), true, entry);
+    std::cout << kDepartmentName[department] << "排名: " << entry.rank << '/'
+              << ranking.size(department)
+              << " (高于 " << ranking.Percentile(student.handle(), true)
+              << "% 的学生)\n";
+}
+
+// gpa-cut <percent> [department], the GPA needed to be in the top percent%
+void CommandLineInterface::ShowGpaCutoff()
+{
+    if (interactive_mode)
+    {
+        if (!ReadLineIntoStream("请输入百分比 (其后可给出院系编号): "))
+            return;
+    }
+
+    double percent;
+    if (!(command_stream_ >> percent) || !(percent > 0 && percent <= 100))
+    {
+        std::cout << "无效的百分比\n";
+        return;
+    }
+    int department = GpaRanking::kAllDepartments;
+    if (command_stream_ >> department &&
+        (department < 0 || department >= kDepartmentNum))
+    {
+        std::cout << "无效的院系编号\n";
+        return;
+    }
+
+    const GpaRanking &ranking = manager_.Ranking();
+    ScoreType cutoff = ranking.Cutoff(percent, department);
+    if (cutoff == kInvalidScore)
+    {
+        std::cout << "没有学生有GPA\n";
+        return;
+    }
+    std::cout << "前 " << percent << "% 的GPA线: " << cutoff << " (共 "
+              << ranking.size(department) << " 名学生有GPA)\n";
+}
+
+// report <directory>, into departments.csv and courses.csv
+void CommandLineInterface::WriteReport() const
+{
+    if (interactive_mode)
+    {
+        if (!ReadLineIntoStream("请输入报表的输出目录: "))
+            return;
+    }
+
+    std::string directory;
+    if (!(command_stream_ >> directory))
+    {
+        std::cout << "无效的目录\n";
+        return;
+    }
+    if (directory.size() > 1 && directory.back() == '/')
+        directory.pop_back();
+
+    Report report;
+    report.Build(manager_);
+    std::cout << "已统计 " << kDepartmentNum << " 个院系和 "
+              << report.courses().size() << " 门课程, 用时 "
+              << report.seconds() << " 秒\n";
+
+    std::string departments_file = directory + "/departments.csv";
+    if (!report.WriteDepartments(departments_file))
+        std::cout << "无法写入 " << departments_file << '\n';
+    std::string courses_file = directory + "/courses.csv";
+    if (!report.WriteCourses(courses_file))
+        std::cout << "无法写入 " << courses_file << '\n';
+}
+
+// pct <score> [department | course ID], from the score sketches
+void CommandLineInterface::ShowPercentile() const
+{
+    if (interactive_mode)
+    {
+        if (!ReadLineIntoStream("请输入成绩 (其后可给出院系编号或课程号): "))
+            return;
+    }
+
+    ScoreType score;
+    if (!(command_stream_ >> score) || score == kInvalidScore ||
+        score != score)
+    {
+        std::cout << "无效的成绩\n";
+        return;
+    }
+
+    ScoreSketch sketch;
+    std::string scope;
+    if (!(command_stream_ >> scope))
+    {
+        sketch = manager_.MergeSketches(GpaRanking::kAllDepartments);
+        scope = "全校";
+    }
+    else if (scope.find_first_not_of("0123456789") == std::string::npos)
+    {
+        int department = std::atoi(scope.c_str());
+        if (scope.size() > 2 || department >= kDepartmentNum)
+        {
+            std::cout << "无效的院系编号\n";
+            return;
+        }
+        sketch = manager_.MergeSketches(department);
+        scope = kDepartmentName[department];
+    }
+    else
+    {
+        CourseHandle course = manager_.FindCourseHandle(scope);
+        if (course == kNoCourse)
+        {
+            std::cout << "无效的课程号\n";
+            return;
+        }
+        sketch = manager_.course(course).sketch();
+        scope = "课程 " + scope + ' ';
+    }
+
+    if (sketch.empty())
+    {
+        std::cout << scope << "还没有成绩\n";
+        return;
+    }
+    std::cout << scope << "共 " << sketch.size() << " 个成绩, " << score
+              << " 分约排第 " << sketch.Rank(score) << " 名, 高于约 "
+              << sketch.Percentile(score) << "% 的成绩 (相差不到 "
+              << sketch.resolution() << " 分的成绩不作区分)\n"
+              << "中位数约为 " << sketch.Quantile(0.5) << '\n';
+}
+
+void CommandLineInterface::ApplyBatch()
+{
+    if (interactive_mode)
+    {
+        if (!ReadLineIntoStream("请输入修改文件的文件名: "))
+            return;
+    }
+
+    std::string filename;
+    if (!(command_stream_ >> filename))
+    {
+        std::cout << "无效的文件名\n";
+        return;
+    }
+
+    Manager::Batch batch(manager_);
+    ManagerReader reader;
+    std::size_t bad_line;
+
+    if (!reader.ReadBatch(filename, batch, bad_line, &log_))
+    {
+        log_.Abort();
+        if (bad_line == 0)
+            std::cout << "无法打开文件 " << filename << '\n';
+        else
+            std::cout << "格式错误 (" << reader.error().ToString()
+                      << "), 未做任何修改\n";
+        return;
+    }
+
+    std::size_t edit_num = batch.size();
+    std::size_t first_failure = batch.first_failure();
+    if (batch.Commit())
+    {
+        std::cout << "已应用 " << edit_num << " 条修改\n";
+    }
+    else
+    {
+        log_.Abort();
+        std::cout << "第 " << first_failure + 1 << " 条修改无效, 未做任何修改\n";
+    }
+}
+
+void CommandLineInterface::RenumberStudents()
+{
+    if (interactive_mode)
+    {
+        if (!ReadLineIntoStream("请输入学号对照文件的文件名: "))
+            return;
+    }
+
+    std::string filename;
+    if (!(command_stream_ >> filename))
+    {
+        std::cout << "无效的文件名\n";
+        return;
+    }
+
+    Manager::IDMap id_map;
+    ManagerReader reader;
+    std::size_t bad_line;
+
+    if (!reader.ReadIDMap(filename, id_map, bad_line))
+    {
+        if (bad_line == 0)
+            std::cout << "无法打开文件 " << filename << '\n';
+        else
+            std::cout << "格式错误 (" << reader.error().ToString()
+                      << "), 未做任何修改\n";
+        return;
+    }
+
+    std::vector<RenumberConflict> conflicts;
+    if (manager_.RenumberStudents(id_map, conflicts))
+    {
+        log_.RenumberStudents(id_map);
+        std::cout << "已处理 " << id_map.size() << " 条学号修改\n";
+        return;
+    }
+
+    static const char *kReasons[] = {
+        "不存在该学生", "旧学号重复", "新学号重复", "新学号已被占用"
+    };
+    for (const auto &conflict : conflicts)
+    {
+        std::cout << conflict.old_id << " -> " << conflict.new_id << ": "
+                  << kReasons[conflict.reason] << '\n';
+    }
+    std::cout << "共 " << conflicts.size() << " 处冲突, 未做任何修改\n";
+}
+
+// Edits are already in the log, so only a snapshot out of sync (or a log
+// that has grown large) costs a write, and then only of the departments
+// edited since the last one.
+// save, or "save force" to start from the current data after a failed load
 void CommandLineInterface::Save()
 {
-    ManagerWriter writer;
+    if (load_failed_)
+    {
+        std::string answer;
+        if (interactive_mode)
+            ReadLine("数据未能加载, 保存会覆盖原有的数据文件, 确定吗? (y/n): ",
+                     answer);
+        else
+            command_stream_ >> answer;
+
+        if (answer != "y" && answer != "force")
+        {
+            std::cout << "数据未能加载, 没有保存\n";
+            return;
+        }
+    }
+
+    bool saved;
 
-    if (!writer.Write("students.dat", "courses.dat", manager_))
+    if (!log_.is_open())
+    {
+        // not loaded, or the log has failed: start over from this data,
+        // replacing what the old log has
+        LogReplaySummary summary;
+        saved = log_.Open(kLogFileName, 0, nullptr, summary) &&
+                log_.Checkpoint(snapshot_, manager_);
+    }
+    else if (!snapshot_.in_sync() || log_.NeedsCheckpoint())
+    {
+        saved = log_.Checkpoint(snapshot_, manager_);
+    }
+    else
+    {
+        saved = log_.Commit();
+    }
+
+    if (!saved)
         std::cout << "Failed to save\n";
+    else
+        load_failed_ = false;  // the files hold this data now
 }
 
 
+// Prefer the segmented snapshot, then a single one from an older version,
+// the text files are only read when there is neither (or converted back by
+// sam_convert). Edits logged since the snapshot are applied afterwards.
 void CommandLineInterface::Load()
 {
-    ManagerReader reader;
+    log_.Close();
+
+    // start afresh, the log would be applied twice otherwise
+    manager_.Clear();
+    snapshot_.Reset();
+
+    std::uint64_t log_sequence = 0;
+    if (snapshot_.Read(manager_))
+    {
+        log_sequence = snapshot_.log_sequence();
+    }
+    else
+    {
+        SnapshotReader snapshot_reader;
+        if (snapshot_reader.Read(kSnapshotFileName, manager_))
+        {
+            log_sequence = snapshot_reader.log_sequence();
+        }
+        else
+        {
+            ManagerReader reader;
 
-    if (!reader.Read("students.dat", "courses.dat", manager_))
-        std::cout << "Failed to load\n";
+            if (!reader.Read("students.dat", "courses.dat", manager_))
+            {
+                std::cout << "Failed to load";
+                if (reader.error().line != 0)
+                    std::cout << " (" << reader.error().ToString() << ')';
+                std::cout << '\n';
+
+                // Nothing to lose if there are no files yet. Otherwise the
+                // log cannot be applied, and saving would replace the files
+                // with what little has been read.
+                if (FileExists("students.dat") || FileExists("courses.dat"))
+                {
+                    manager_.Clear();
+                    load_failed_ = true;
+                    std::cout << "数据未能加载, 修改将不会保存\n";
+                    return;
+                }
+            }
+        }
+    }
+    load_failed_ = false;
+
+    LogReplaySummary summary;
+    if (!log_.Open(kLogFileName, log_sequence, &manager_, summary))
+    {
+        std::cout << "Failed to open " << kLogFileName << '\n';
+        return;
+    }
+
+    if (summary.group_num != 0)
+    {
+        std::cout << "已从日志恢复 " << summary.record_num << " 条修改";
+        if (summary.failed_num != 0)
+            std::cout << ", 其中 " << summary.failed_num << " 条无法应用";
+        std::cout << '\n';
+    }
+    if (summary.torn)
+        std::cout << "日志末尾有一组未完成的修改, 已丢弃\n";
+}
+
+// Make the edits of the last command durable, all of them with one write,
+// and fold the log into the snapshot once it has grown large.
+void CommandLineInterface::CommitLog()
+{
+    if (!log_.Commit())
+    {
+        std::cout << "Failed to write " << kLogFileName << '\n';
+    }
+    else if (log_.NeedsCheckpoint())
+    {
+        if (!log_.Checkpoint(snapshot_, manager_))
+            std::cout << "Failed to save\n";
+    }
 }
 
 bool CommandLineInterface::GetStudentID(const char *prompt,
@@ -10,6 +10,8 @@
 
 #include "interface.h"
 #include "manager.h"
+#include "mutation_log.h"
+#include "segmented_snapshot.h"
 
 namespace SAM {
 
@@ -32,6 +34,7 @@ class CommandLineInterface : public Interface
     void ListStudents() const;
     void AddStudent();
     void RemoveStudent();
+    void RemoveCohort();
     void ShowStudent() const;
 
     void ListCourses() const;
@@ -40,16 +43,29 @@ class CommandLineInterface : public Interface
     void ShowCourse() const;
 
     void RegisterToCourse();
+    void RegisterManyToCourse();
     void DropFromCourse();
 
     void RecordFinalScore();
+    void ImportFinalScores();
     void RemoveFinalScore();
     void ChangeScore();
 
     void GenerateTranscript() const;
+    void GenerateAllTranscripts() const;
+
+    void ShowTopStudents();
+    void ShowRank();
+    void ShowGpaCutoff();
+    void WriteReport() const;
+    void ShowPercentile() const;
+
+    void ApplyBatch();
+    void RenumberStudents();
 
     void Save();
     void Load();
+    void CommitLog();
 
     void PrintHelpInfo() const;
 
@@ -87,6 +103,11 @@ class CommandLineInterface : public Interface
     std::string prompt_;
     mutable std::istringstream command_stream_;
     Manager manager_;
+    MutationLog log_;             // edits since the snapshot
+    SegmentedSnapshot snapshot_;  // what the log builds on
+    // The data files could not be read: nothing is saved unless confirmed,
+    // so that they are not replaced
+    bool load_failed_;
 
     bool interactive_mode;
 };
@@ -1,4 +1,7 @@
+#include <algorithm>
+
 #include "common.h"
+#include "text_parser.h"
 
 namespace SAM {
 
@@ -52,14 +55,122 @@ const char *kDepartmentName[kDepartmentNum] = {
     "软件学院"  // 45
 };
 
-bool MakeCourseInfo(const std::string &str, CourseInfo &info)
+const char *kSeasonName[3] = {
+    "春", "夏", "秋"
+};
+
+namespace {
+
+const int kMaxYear = 9999;
+
+// Read the digits at str[pos, end) into value, false if there is none or
+// value would exceed max_value
+bool ParseNumber(const std::string &str, std::size_t pos, std::size_t end,
+                 std::uint64_t max_value, std::uint64_t &value)
+{
+    if (pos >= end)
+        return false;
+
+    value = 0;
+    for (; pos < end; pos++)
+    {
+        if (str[pos] < '0' || str[pos] > '9')
+            return false;
+        value = value * 10 + (str[pos] - '0');
+        if (value > max_value)
+            return false;
+    }
+    return true;
+}
+
+// The year and then the season at str[0, end), the season may be left out
+// if allowed
+bool ParseYearSeason(const std::string &str, std::size_t end,
+                     bool season_optional, int &year, int &season)
 {
-    std::istringstream iss(str);
-    if (iss >> info.id >> info.name >> info.department >> info.credit
-            >> info.capacity >> info.teacher_name)
+    std::size_t year_end = 0;
+    while (year_end < end && str[year_end] >= '0' && str[year_end] <= '9')
+        year_end++;
+
+    std::uint64_t value;
+    if (!ParseNumber(str, 0, year_end, kMaxYear, value))
+        return false;
+    year = static_cast<int>(value);
+
+    if (year_end == end && season_optional)
+    {
+        season = -1;
         return true;
-    else
+    }
+    for (season = SPRING; season <= FALL; season++)
+    {
+        if (str.compare(year_end, end - year_end, kSeasonName[season]) == 0)
+            return true;
+    }
+    return false;
+}
+
+}  // namespace
+
+CourseKey MakeCourseKey(const CourseInfo::IDType &course_id)
+{
+    std::size_t dash_position = course_id.find('-');
+    if (dash_position == std::string::npos)
+        return kNoCourseKey;
+
+    int year, season;
+    std::uint64_t number;
+    if (!ParseYearSeason(course_id, dash_position, false, year, season) ||
+        !ParseNumber(course_id, dash_position + 1, course_id.size(),
+                     0x7FFFFFFF, number))  // to fit CourseIDInfo::id
+        return kNoCourseKey;
+
+    return MakeCourseKey(year, static_cast<Season>(season),
+                         static_cast<std::uint32_t>(number));
+}
+
+bool ParseSemester(const std::string &str, CourseKey &begin, CourseKey &end)
+{
+    int year, season;
+    if (!ParseYearSeason(str, str.size(), true, year, season))
         return false;
+
+    if (season < 0)  // the whole year
+    {
+        begin = MakeCourseKey(year, SPRING, 0);
+        end = MakeCourseKey(year + 1, SPRING, 0);
+    }
+    else
+    {
+        begin = MakeCourseKey(year, static_cast<Season>(season), 0);
+        end = begin + (1ULL << 32);
+    }
+    return true;
+}
+
+void SortFinalScore(FinalScore &final_score)
+{
+    std::stable_sort(final_score.begin(), final_score.end(),
+                     [](const ScorePiece &lhs, const ScorePiece &rhs)
+                     {
+                         return lhs.id < rhs.id;
+                     });
+
+    std::size_t kept = 0;
+    for (const ScorePiece &score_piece : final_score)
+    {
+        if (kept != 0 && final_score[kept - 1].id == score_piece.id)
+            final_score[kept - 1] = score_piece;  // a later one
+        else
+            final_score[kept++] = score_piece;
+    }
+    final_score.resize(kept);
+}
+
+bool MakeCourseInfo(const std::string &str, CourseInfo &info)
+{
+    TextParser parser(str);
+    return parser.NextLine() && parser.ReadCourseInfo(info);
 }
 
 std::string to_string(const CourseInfo &info)
@@ -76,11 +187,8 @@ std::string to_string(const CourseInfo &info)
 
 bool MakeStudentInfo(const std::string &str, StudentInfo &info)
 {
-    std::istringstream iss(str);
-    if (iss >> info.id >> info.name >> info.is_male >> info.department)
-        return true;
-    else
-        return false;
+    TextParser parser(str);
+    return parser.NextLine() && parser.ReadStudentInfo(info);
 }
 
 std::string to_string(const StudentInfo &info)
@@ -28,6 +28,35 @@ struct CourseInfo
     std::string teacher_name;
 };
 
+// A course ID in the THU format, yyyyS-xxxxxxxx (year, season and number,
+// like 2014秋-30240233), packed into 64 bits so that keys sort by semester
+// and then by number. Other IDs get kNoCourseKey, which sorts last.
+typedef std::uint64_t CourseKey;
+const CourseKey kNoCourseKey = ~0ULL;
+
+enum Season { SPRING, SUMMER, FALL };  // no winter
+extern const char *kSeasonName[3];
+
+inline CourseKey MakeCourseKey(int year, Season season, std::uint32_t number)
+{
+    return static_cast<CourseKey>(year) << 34 |
+           static_cast<CourseKey>(season) << 32 | number;
+}
+inline int CourseKeyYear(CourseKey key) { return static_cast<int>(key >> 34); }
+inline Season CourseKeySeason(CourseKey key)
+{ return static_cast<Season>(key >> 32 & 3); }
+inline std::uint32_t CourseKeyNumber(CourseKey key)
+{ return static_cast<std::uint32_t>(key); }
+
+CourseKey MakeCourseKey(const CourseInfo::IDType &course_id);
+// The keys of a semester ("2014秋") or a year ("2014"): [begin, end)
+bool ParseSemester(const std::string &str, CourseKey &begin, CourseKey &end);
+
+// Compact reference to a course held by a Manager, only the I/O and the
+// interface need to deal with the ID string.
+typedef std::uint32_t CourseHandle;
+const CourseHandle kNoCourse = 0xFFFFFFFFu;
+
 
 struct StudentInfo
 {
@@ -39,6 +68,10 @@ struct StudentInfo
     int department;
 };
 
+// Compact reference to a student held by a Manager
+typedef std::uint32_t StudentHandle;
+const StudentHandle kNoStudent = 0xFFFFFFFFu;
+
 
 
 typedef float ScoreType;
@@ -52,6 +85,9 @@ struct ScorePiece
 
 typedef std::vector<ScorePiece> FinalScore;
 
+// Sort by student ID, keeping only the last score given to each student
+void SortFinalScore(FinalScore &final_score);
+
 bool MakeCourseInfo(const std::string &str, CourseInfo &info);
 std::string to_string(const CourseInfo &info);
 bool MakeStudentInfo(const std::string &str, StudentInfo &info);
@@ -1,95 +1,112 @@
-#include <algorithm>
 #include <iomanip>
-#include <iterator>
 #include <sstream>
 
 #include "course.h"
 
 namespace SAM {
 
-Course::Course(const CourseInfo &info)
+Course::Course(const CourseInfo &info, CourseHandle handle,
+               EnrollmentIndex *enrollment)
         : info_(info),
-          final_score_()
+          key_(MakeCourseKey(info.id)),
+          handle_(handle),
+          enrollment_(enrollment),
+          statistics_()
 {
 }
 
+const ScoreSketch Course::kNoSketch;
+const std::size_t Course::kMinMergeSize;
+
 void Course::RecordFinalScore(const FinalScore &final_score,
-                              std::vector<Student::IDType> &unscored_students)
+                              std::vector<Student::IDType> &unscored_students,
+                              std::vector<Student::IDType> &not_enrolled)
 {
+    if (final_score.size() >= kMinMergeSize)
+    {
+        FinalScore sorted(final_score);
+        SortFinalScore(sorted);
+        MergeFinalScore(sorted, unscored_students, not_enrolled);
+        return;
+    }
+
     for (const auto &score_piece : final_score)
     {
-        ChangeScore(score_piece.id, score_piece.score);
+        if (!ChangeScore(score_piece.id, score_piece.score))
+            not_enrolled.push_back(score_piece.id);
     }
 
-    for (const auto &score_piece : final_score_)
+    RosterView roster = this->final_score();
+    for (std::size_t index = 0; index < roster.size(); index++)
     {
-        if (score_piece.score == kInvalidScore)
+        if (roster.scores()[index] == kInvalidScore)
         {
             // no score given
-            unscored_students.push_back(score_piece.id);
+            unscored_students.push_back(roster.ids()[index]);
         }
     }
 }
 
+void Course::MergeFinalScore(const FinalScore &final_score,
+                             std::vector<Student::IDType> &unscored_students,
+                             std::vector<Student::IDType> &not_enrolled)
+{
+    enrollment_->MergeScores(handle_, final_score, not_enrolled,
+                             &unscored_students);
+}
+
 void Course::RemoveFinalScore()
 {
-    for (auto &score_piece : final_score_)
-        score_piece.score = kInvalidScore;
+    enrollment_->ClearScores(handle_);
 }
 
-bool Course::AddStudent(Student &student)
+bool Course::AddStudent(const Student &student)
 {
     if (IsFull())
         return false;
 
-    student.AddCourse(info_.id);
-
-    auto student_id = student.info().id;
-    auto range_pair = EqualRange(student_id);
-    if (range_pair.first == range_pair.second)  // have not record this student
-    {
-        final_score_.insert(range_pair.first,
-                            ScorePiece{student_id, kInvalidScore});
-    }
-
+    enrollment_->Enroll(handle_, student.handle(), student.info().id);
     return true;
 }
 
-void Course::RemoveStudent(Student &student)
+void Course::RemoveStudent(const Student &student)
 {
-    student.RemoveCourse(info_.id);
-
-    auto range_pair = EqualRange(student.info().id);
-    final_score_.erase(range_pair.first, range_pair.second);
+    enrollment_->Drop(handle_, student.handle(), student.info().id);
 }
 
 bool Course::HasStudent(Student::IDType student_id) const
 {
-    auto range_pair = EqualRange(student_id);
-    return range_pair.first != range_pair.second;
+    RosterView roster = final_score();
+    return roster.Find(student_id) != roster.size();
 }
 
 ScoreType Course::GetScore(Student::IDType student_id) const
 {
-    auto range_pair = EqualRange(student_id);
-
-    if (range_pair.first == range_pair.second)
-        return kInvalidScore;  // invalid student_id
-    else
-        return range_pair.first->score;
+    return enrollment_ ? enrollment_->Score(handle_, student_id)
+                       : kInvalidScore;
 }
 
 bool Course::ChangeScore(Student::IDType student_id, ScoreType new_score)
 {
-    auto range_pair = EqualRange(student_id);
+    return enrollment_->SetScore(handle_, student_id, new_score);
+}
+
+std::shared_ptr<const CourseStatistics> Course::statistics() const
+{
+    std::uint64_t generation =
+            enrollment_ ? enrollment_->RosterGeneration(handle_) : 0;
 
-    if (range_pair.first != range_pair.second)
+    auto cache = std::atomic_load(&statistics_);
+    if (!cache || cache->generation != generation)
     {
-        range_pair.first->score = new_score;
-        return true;
+        cache = std::make_shared<const StatisticsCache>(
+                StatisticsCache{generation,
+                                CourseStatistics(final_score())});
+        std::atomic_store(&statistics_, cache);
     }
 
-    return false;
+    // shares the ownership of the cache
+    return std::shared_ptr<const CourseStatistics>(cache, &cache->statistics);
 }
 
 std::string Course::Heading()
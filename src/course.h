@@ -1,18 +1,22 @@
 #ifndef SAM_COURSE_H_
 #define SAM_COURSE_H_
 
-#include <algorithm>
+#include <cstdint>
+
+#include <memory>
 #include <ostream>
 #include <string>
-#include <utility>
 #include <vector>
 
 #include "common.h"
+#include "course_statistics.h"
+#include "enrollment.h"
 #include "student.h"
 
 namespace SAM {
 
 // Store the basic information of a course, and manage final score.
+// The roster itself is kept by the EnrollmentIndex of the Manager.
 // id shall be UNIQUE, so a same class in different semester should have
 // different id.
 class Course
@@ -20,13 +24,15 @@ class Course
  public:
     typedef CourseInfo::IDType IDType;
 
-    Course() = default;
-    explicit Course(const CourseInfo &info);
+    Course() : info_(), key_(kNoCourseKey), handle_(kNoCourse),
+               enrollment_(nullptr), statistics_() {}
+    explicit Course(const CourseInfo &info, CourseHandle handle = kNoCourse,
+                    EnrollmentIndex *enrollment = nullptr);
 
     // The course-taking information will be updated after calling these.
     // Cannot add if the course if full
-    bool AddStudent(Student &student);
-    void RemoveStudent(Student &student);
+    bool AddStudent(const Student &student);
+    void RemoveStudent(const Student &student);
     // Check whether a certain student is in the course.
     bool HasStudent(Student::IDType student_id) const;
     bool HasStudent(const Student &student) const
@@ -34,9 +40,17 @@ class Course
 
     // If a student is unscored after update, his ID will be added to the back
     // of unscored_students.
-    // If a student has more than one score, the last one will be taken
+    // If a student has more than one score, the last one will be taken.
+    // Scores of students not in the course are ignored, their IDs will be
+    // added to the back of not_enrolled.
+    // Many scores are sorted and merged into the roster in one pass.
     void RecordFinalScore(const FinalScore &final_score,
-                          std::vector<Student::IDType> &unscored_students);
+                          std::vector<Student::IDType> &unscored_students,
+                          std::vector<Student::IDType> &not_enrolled);
+    // The same for final_score already sorted by SortFinalScore()
+    void MergeFinalScore(const FinalScore &final_score,
+                         std::vector<Student::IDType> &unscored_students,
+                         std::vector<Student::IDType> &not_enrolled);
     void RemoveFinalScore();
 
     // If the student is not in this course, kInvalidScore will be returned.
@@ -47,16 +61,33 @@ class Course
     // If the arguments are invalid, nothing will be done
     bool ChangeScore(Student::IDType student_id, ScoreType new_score);
 
-    bool IsFull() const { return final_score_.size() == info_.capacity; }
+    bool IsFull() const { return StudentNumber() == info_.capacity; }
 
     // accessors
     const CourseInfo & info() const { return info_; }
-    const FinalScore & final_score() const { return final_score_; }
-    std::size_t StudentNumber() const { return final_score_.size(); }
+    // parsed from the ID once, kNoCourseKey if not in the THU format
+    CourseKey key() const { return key_; }
+    CourseHandle handle() const { return handle_; }
+    RosterView final_score() const
+    { return enrollment_ ? enrollment_->Roster(handle_) : RosterView(); }
+    std::size_t StudentNumber() const { return final_score().size(); }
     // to get a student list, use final_score()
 
+    // Worked out on first use, and again once the roster has changed.
+    // Safe to call from several threads while the course is not changed.
+    std::shared_ptr<const CourseStatistics> statistics() const;
+    // Kept up to date with every change of a score, see ScoreSketch.
+    // Approximate, but needs no sorting however large the course is.
+    const ScoreSketch & sketch() const
+    { return enrollment_ ? enrollment_->Sketch(handle_) : kNoSketch; }
+
     // mutators
-    void set_info(const CourseInfo &info) { info_ = info; }
+    void set_info(const CourseInfo &info)
+    {
+        if (info.id != info_.id)
+            key_ = MakeCourseKey(info.id);
+        info_ = info;
+    }
 
     // Return the heading for display
     static std::string Heading();
@@ -79,30 +110,23 @@ class Course
     static const int teacher_name_width = 6;
 
  private:
-    std::pair<FinalScore::const_iterator, FinalScore::const_iterator>
-    EqualRange(Student::IDType student_id) const
-    {
-        return std::equal_range(final_score_.begin(),
-                                final_score_.end(),
-                                ScorePiece{student_id, 0},
-                                [](const ScorePiece &lhs,
-                                   const ScorePiece &rhs)
-                                { return lhs.id < rhs.id; });
-    }
+    static const ScoreSketch kNoSketch;
 
-    std::pair<FinalScore::iterator, FinalScore::iterator>
-    EqualRange(Student::IDType student_id)
-    {
-        return std::equal_range(final_score_.begin(),
-                                final_score_.end(),
-                                ScorePiece{student_id, 0},
-                                [](const ScorePiece &lhs,
-                                   const ScorePiece &rhs)
-                                { return lhs.id < rhs.id; });
-    }
+    // Below this, scores are looked up one by one rather than sorted
+    static const std::size_t kMinMergeSize = 64;
 
     CourseInfo info_;
-    FinalScore final_score_;  // always sorted
+    CourseKey key_;
+    CourseHandle handle_;  // what students taking this course refer to
+    EnrollmentIndex *enrollment_;
+
+    struct StatisticsCache
+    {
+        std::uint64_t generation;  // of the roster
+        CourseStatistics statistics;
+    };
+    // swapped with std::atomic_load/store
+    mutable std::shared_ptr<const StatisticsCache> statistics_;
 };
 
 std::ostream & operator<<(std::ostream &os, const Course &course);
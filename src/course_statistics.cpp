@@ -0,0 +1,46 @@
+#include <algorithm>
+
+#include "course_statistics.h"
+
+namespace SAM {
+
+const std::size_t CourseStatistics::kBucketWidth;
+const std::size_t CourseStatistics::kBucketNum;
+
+CourseStatistics::CourseStatistics()
+        : summary_(SummarizeScores(nullptr, 0)), sorted_scores_(), histogram_()
+{
+    histogram_.fill(0);
+}
+
+CourseStatistics::CourseStatistics(RosterView roster)
+        : summary_(SummarizeScores(roster.scores(), roster.size())),
+          sorted_scores_(), histogram_()
+{
+    histogram_.fill(0);
+    sorted_scores_.reserve(summary_.count);
+
+    for (std::size_t index = 0; index < roster.size(); index++)
+    {
+        ScoreType score = roster.scores()[index];
+        if (score == kInvalidScore || score != score)  // or NaN, unordered
+            continue;
+
+        sorted_scores_.push_back(score);
+        histogram_[BucketOf(score)]++;
+    }
+
+    std::sort(sorted_scores_.begin(), sorted_scores_.end());
+}
+
+int CourseStatistics::Rank(ScoreType score) const
+{
+    if (score == kInvalidScore)
+        return 0;
+
+    auto above = std::upper_bound(sorted_scores_.begin(), sorted_scores_.end(),
+                                  score);
+    return 1 + static_cast<int>(sorted_scores_.end() - above);
+}
+
+}  // namespace SAM
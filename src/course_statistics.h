@@ -0,0 +1,57 @@
+#ifndef SAM_COURSE_STATISTICS_H_
+#define SAM_COURSE_STATISTICS_H_
+
+#include <cstddef>
+
+#include <array>
+#include <vector>
+
+#include "common.h"
+#include "enrollment.h"
+#include "score_kernels.h"
+
+namespace SAM {
+
+// What a transcript needs to know about the scores of a course, worked out
+// once from its roster. Invalid scores are left out.
+class CourseStatistics
+{
+ public:
+    // buckets of 10 points, the last one for 100 and above
+    static const std::size_t kBucketWidth = 10;
+    static const std::size_t kBucketNum = 11;
+    typedef std::array<std::size_t, kBucketNum> Histogram;
+    static std::size_t BucketOf(ScoreType score)
+    {
+        if (score >= kBucketWidth * (kBucketNum - 1))
+            return kBucketNum - 1;
+        return score > 0 ? static_cast<std::size_t>(score / kBucketWidth) : 0;
+    }
+
+    CourseStatistics();
+    explicit CourseStatistics(RosterView roster);
+
+    std::size_t valid_num() const { return summary_.count; }
+    // kInvalidScore if there is no valid score
+    ScoreType min_score() const { return summary_.min_score; }
+    ScoreType max_score() const { return summary_.max_score; }
+    double mean() const { return summary_.mean(); }
+    double variance() const { return summary_.variance(); }
+    const ScoreSummary & summary() const { return summary_; }
+
+    // 1 + the number of scores above score, 0 for kInvalidScore
+    int Rank(ScoreType score) const;
+
+    const std::vector<ScoreType> & sorted_scores() const  // ascending
+    { return sorted_scores_; }
+    const Histogram & histogram() const { return histogram_; }
+
+ private:
+    ScoreSummary summary_;
+    std::vector<ScoreType> sorted_scores_;
+    Histogram histogram_;
+};
+
+}  // namespace SAM
+
+#endif  // SAM_COURSE_STATISTICS_H_
@@ -0,0 +1,424 @@
+#ifndef SAM_DENSE_STORE_H_
+#define SAM_DENSE_STORE_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+namespace SAM {
+
+// Items are kept in a contiguous slot array and found through a flat
+// open-addressing (linear probing) hash index from key to slot.
+// A slot number (Handle) stays valid until the item is erased, so it can be
+// used as a compact reference to the item. Erased slots are reused.
+// Iteration is in key order, through a sorted view which is only brought up
+// to date when it is needed, so a run of insertions costs a single sort.
+// Any mutation invalidates iterators (but not handles).
+template <typename KeyType, typename ItemType,
+          typename Hash = std::hash<KeyType>>
+class DenseStore
+{
+ public:
+    typedef std::uint32_t Handle;
+    static const Handle kNoHandle = 0xFFFFFFFFu;
+
+    class ConstIterator
+            : public std::iterator<std::bidirectional_iterator_tag, ItemType>
+    {
+     public:
+        ConstIterator() : store_(nullptr), rank_(0) {}
+        ConstIterator(const DenseStore *store, std::size_t rank)
+                : store_(store), rank_(rank) {}
+
+        bool operator==(const ConstIterator &rhs) const
+        { return rank_ == rhs.rank_ && store_ == rhs.store_; }
+
+        bool operator!=(const ConstIterator &rhs) const
+        { return !(*this == rhs); }
+
+        const ItemType & operator*() const
+        { return store_->items_[store_->sorted_[rank_]]; }
+        const ItemType * operator->() const { return &**this; }
+
+        Handle handle() const { return store_->sorted_[rank_]; }
+
+        ConstIterator & operator++()
+        {
+            ++rank_;
+            return *this;
+        }
+
+        ConstIterator operator++(int)
+        {
+            ConstIterator old(*this);
+            ++rank_;
+            return old;
+        }
+
+        ConstIterator & operator--()
+        {
+            --rank_;
+            return *this;
+        }
+
+        ConstIterator operator--(int)
+        {
+            ConstIterator old(*this);
+            --rank_;
+            return old;
+        }
+
+     private:
+        const DenseStore *store_;
+        std::size_t rank_;
+    };
+
+    DenseStore() : items_(), keys_(), live_(), free_slots_(), table_(),
+                   size_(0), used_buckets_(0), sorted_(), rank_(),
+                   pending_(), in_view_(), view_stale_(false) {}
+
+    // Return kNoHandle if the key has been taken.
+    Handle Insert(const KeyType &key, const ItemType &item)
+    {
+        ReserveBucket();
+
+        std::size_t hash = HashOf(key);
+        std::size_t bucket;
+        if (Probe(key, hash, bucket))
+            return kNoHandle;
+
+        Handle slot;
+        if (!free_slots_.empty())
+        {
+            slot = free_slots_.back();
+            free_slots_.pop_back();
+            items_[slot] = item;
+            keys_[slot] = key;
+            live_[slot] = true;
+        }
+        else
+        {
+            slot = static_cast<Handle>(items_.size());
+            items_.push_back(item);
+            keys_.push_back(key);
+            live_.push_back(true);
+            in_view_.push_back(false);
+            rank_.push_back(0);
+        }
+
+        Occupy(bucket, hash, slot);
+        size_++;
+        pending_.push_back(slot);
+        return slot;
+    }
+
+    void Erase(Handle slot)
+    {
+        Vacate(slot);
+
+        live_[slot] = false;
+        items_[slot] = ItemType();
+        keys_[slot] = KeyType();
+        free_slots_.push_back(slot);
+        size_--;
+    }
+
+    // Change the key of a live item, keeping its slot.
+    // Return false if the new key has been taken.
+    bool Rekey(Handle slot, const KeyType &new_key)
+    {
+        if (keys_[slot] == new_key)
+            return true;
+
+        ReserveBucket();
+
+        std::size_t hash = HashOf(new_key);
+        std::size_t bucket;
+        if (Probe(new_key, hash, bucket))
+            return false;
+
+        Vacate(slot);
+        Occupy(bucket, hash, slot);
+        keys_[slot] = new_key;
+        pending_.push_back(slot);
+        return true;
+    }
+
+    // Change the keys of many items at once, so they may swap keys.
+    // Every new key shall be free once the old keys of these items are gone.
+    void RekeyMany(const std::vector<std::pair<Handle, KeyType>> &changes)
+    {
+        for (const auto &change : changes)
+            Vacate(change.first);
+        for (const auto &change : changes)
+        {
+            keys_[change.first] = change.second;
+            pending_.push_back(change.first);
+        }
+
+        for (const auto &change : changes)
+        {
+            if ((used_buckets_ + 1) * 4 > table_.size() * 3)
+            {
+                Rehash(TableSizeFor(size_ * 2 + 1));  // puts back all of them
+                return;
+            }
+
+            std::size_t hash = HashOf(change.second);
+            std::size_t bucket;
+            Probe(change.second, hash, bucket);
+            Occupy(bucket, hash, change.first);
+        }
+    }
+
+    Handle Find(const KeyType &key) const
+    {
+        if (table_.empty())
+            return kNoHandle;
+
+        std::size_t bucket;
+        if (Probe(key, HashOf(key), bucket))
+            return table_[bucket].slot;
+        return kNoHandle;
+    }
+
+    bool Contains(const KeyType &key) const
+    { return Find(key) != kNoHandle; }
+
+    bool IsLive(Handle slot) const
+    { return slot < live_.size() && live_[slot]; }
+
+    ItemType & operator[](Handle slot) { return items_[slot]; }
+    const ItemType & operator[](Handle slot) const { return items_[slot]; }
+    const KeyType & key(Handle slot) const { return keys_[slot]; }
+
+    std::size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    // Every handle ever returned is smaller than this.
+    std::size_t HandleLimit() const { return items_.size(); }
+
+    void Reserve(std::size_t count)
+    {
+        items_.reserve(count);
+        keys_.reserve(count);
+        if (table_.size() < TableSizeFor(count))
+            Rehash(TableSizeFor(count));
+    }
+
+    void Clear()
+    {
+        *this = DenseStore();
+    }
+
+    // Iterate in key order
+    ConstIterator begin() const
+    {
+        SyncView();
+        return ConstIterator(this, 0);
+    }
+
+    ConstIterator end() const
+    {
+        SyncView();
+        return ConstIterator(this, sorted_.size());
+    }
+
+    // Return end() if not found
+    ConstIterator Locate(const KeyType &key) const
+    {
+        return Locate(Find(key));
+    }
+
+    ConstIterator Locate(Handle slot) const
+    {
+        SyncView();
+        if (!IsLive(slot))
+            return ConstIterator(this, sorted_.size());
+        return ConstIterator(this, rank_[slot]);
+    }
+
+ private:
+    struct Bucket
+    {
+        Handle slot;
+        std::uint32_t tag;  // high bits of the hash, to skip most key compares
+    };
+
+    static const Handle kEmpty = 0xFFFFFFFFu;
+    static const Handle kDeleted = 0xFFFFFFFEu;
+
+    static std::size_t HashOf(const KeyType &key)
+    {
+        // std::hash is often the identity for integers, so mix the bits
+        // before using the low ones as bucket index.
+        std::uint64_t h = Hash()(key);
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 33;
+        return static_cast<std::size_t>(h);
+    }
+
+    static std::uint32_t TagOf(std::size_t hash)
+    {
+        return static_cast<std::uint32_t>(
+                static_cast<std::uint64_t>(hash) >> 32);
+    }
+
+    static std::size_t TableSizeFor(std::size_t count)
+    {
+        std::size_t table_size = 16;
+        while (table_size * 3 < count * 4 + 4)  // keep load below 3/4
+            table_size *= 2;
+        return table_size;
+    }
+
+    // Return true if found, bucket will be set to the bucket holding key.
+    // Otherwise bucket will be set to where the key should be inserted.
+    bool Probe(const KeyType &key, std::size_t hash, std::size_t &bucket) const
+    {
+        std::size_t mask = table_.size() - 1;
+        std::uint32_t tag = TagOf(hash);
+        std::size_t first_deleted = table_.size();
+
+        for (bucket = hash & mask; ; bucket = (bucket + 1) & mask)
+        {
+            const Bucket &b = table_[bucket];
+            if (b.slot == kEmpty)
+            {
+                if (first_deleted != table_.size())
+                    bucket = first_deleted;
+                return false;
+            }
+            else if (b.slot == kDeleted)
+            {
+                if (first_deleted == table_.size())
+                    first_deleted = bucket;
+            }
+            else if (b.tag == tag && keys_[b.slot] == key)
+            {
+                return true;
+            }
+        }
+    }
+
+    void Occupy(std::size_t bucket, std::size_t hash, Handle slot)
+    {
+        if (table_[bucket].slot == kEmpty)
+            used_buckets_++;
+        table_[bucket].slot = slot;
+        table_[bucket].tag = TagOf(hash);
+    }
+
+    // Remove slot from the hash index and the sorted view
+    void Vacate(Handle slot)
+    {
+        std::size_t bucket;
+        Probe(keys_[slot], HashOf(keys_[slot]), bucket);
+        table_[bucket].slot = kDeleted;
+
+        if (in_view_[slot])
+        {
+            in_view_[slot] = false;
+            view_stale_ = true;
+        }
+    }
+
+    // Make sure there is room for one more bucket
+    void ReserveBucket()
+    {
+        if (table_.empty() || (used_buckets_ + 1) * 4 > table_.size() * 3)
+            Rehash(TableSizeFor(size_ * 2 + 1));
+    }
+
+    void Rehash(std::size_t table_size)
+    {
+        table_.assign(table_size, Bucket{kEmpty, 0});
+        used_buckets_ = 0;
+
+        std::size_t mask = table_size - 1;
+        for (Handle slot = 0; slot < items_.size(); slot++)
+        {
+            if (!live_[slot])
+                continue;
+
+            std::size_t hash = HashOf(keys_[slot]);
+            std::size_t bucket = hash & mask;
+            while (table_[bucket].slot != kEmpty)
+                bucket = (bucket + 1) & mask;
+            Occupy(bucket, hash, slot);
+        }
+    }
+
+    // Bring the sorted view up to date: drop erased or rekeyed slots, sort the
+    // pending ones and merge them in.
+    void SyncView() const
+    {
+        if (pending_.empty() && !view_stale_)
+            return;
+
+        if (view_stale_)
+        {
+            sorted_.erase(std::remove_if(sorted_.begin(), sorted_.end(),
+                                         [this](Handle slot)
+                                         { return !in_view_[slot]; }),
+                          sorted_.end());
+        }
+
+        std::vector<Handle> fresh;
+        fresh.reserve(pending_.size());
+        for (Handle slot : pending_)
+        {
+            if (live_[slot] && !in_view_[slot])  // may be listed twice
+            {
+                in_view_[slot] = true;
+                fresh.push_back(slot);
+            }
+        }
+
+        auto by_key = [this](Handle lhs, Handle rhs)
+                      { return keys_[lhs] < keys_[rhs]; };
+        std::sort(fresh.begin(), fresh.end(), by_key);
+
+        std::size_t old_size = sorted_.size();
+        sorted_.insert(sorted_.end(), fresh.begin(), fresh.end());
+        std::inplace_merge(sorted_.begin(), sorted_.begin() + old_size,
+                           sorted_.end(), by_key);
+
+        for (std::size_t rank = 0; rank < sorted_.size(); rank++)
+            rank_[sorted_[rank]] = rank;
+
+        pending_.clear();
+        view_stale_ = false;
+    }
+
+    std::vector<ItemType> items_;
+    std::vector<KeyType> keys_;
+    std::vector<bool> live_;
+    std::vector<Handle> free_slots_;
+
+    std::vector<Bucket> table_;
+    std::size_t size_;
+    std::size_t used_buckets_;  // live + deleted
+
+    // sorted view
+    mutable std::vector<Handle> sorted_;
+    mutable std::vector<std::size_t> rank_;  // slot -> position in sorted_
+    mutable std::vector<Handle> pending_;  // inserted or rekeyed since sync
+    mutable std::vector<bool> in_view_;
+    mutable bool view_stale_;  // some slots in sorted_ are out of date
+};
+
+template <typename KeyType, typename ItemType, typename Hash>
+const typename DenseStore<KeyType, ItemType, Hash>::Handle
+DenseStore<KeyType, ItemType, Hash>::kNoHandle;
+
+}  // namespace SAM
+
+#endif  // SAM_DENSE_STORE_H_
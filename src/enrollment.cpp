@@ -0,0 +1,841 @@
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+
+#include "enrollment.h"
+
+namespace SAM {
+
+const std::uint32_t EnrollmentIndex::kNotPatched;
+const std::size_t EnrollmentIndex::kMinDeltaSize;
+
+namespace {
+
+// NaN is not counted either, it would spoil the sums for good
+inline bool IsScored(ScoreType score)
+{
+    return score != kInvalidScore && score == score;
+}
+
+}  // namespace
+
+std::size_t RosterView::Find(StudentInfo::IDType id) const
+{
+    const StudentInfo::IDType *pos = std::lower_bound(ids_, ids_ + size_, id);
+    if (pos != ids_ + size_ && *pos == id)
+        return pos - ids_;
+    return size_;
+}
+
+bool CourseList::Contains(CourseHandle course) const
+{
+    return std::binary_search(begin_, end_, course);
+}
+
+EnrollmentIndex::EnrollmentIndex()
+        : roster_offsets_(1, 0),
+          roster_ids_(),
+          roster_students_(),
+          roster_scores_(),
+          course_list_offsets_(1, 0),
+          course_list_courses_(),
+          roster_patch_(),
+          roster_patches_(),
+          course_list_patch_(),
+          course_list_patches_(),
+          delta_size_(0),
+          enrollment_num_(0),
+          course_credits_(),
+          credit_totals_(),
+          credit_changes_(),
+          credit_changed_(),
+          sketches_(),
+          empty_sketch_(),
+          roster_generations_(),
+          last_generation_(0)
+{
+}
+
+RosterView EnrollmentIndex::Roster(CourseHandle course) const
+{
+    if (course >= roster_patch_.size())
+        return RosterView();
+
+    if (roster_patch_[course] != kNotPatched)
+    {
+        const RosterRow &row = roster_patches_[roster_patch_[course] - 1];
+        return RosterView(row.ids.data(), row.students.data(),
+                          row.scores.data(), row.ids.size());
+    }
+
+    std::size_t begin = roster_offsets_[course];
+    return RosterView(roster_ids_.data() + begin,
+                      roster_students_.data() + begin,
+                      roster_scores_.data() + begin,
+                      roster_offsets_[course + 1] - begin);
+}
+
+CourseList EnrollmentIndex::CoursesOf(StudentHandle student) const
+{
+    if (student >= course_list_patch_.size())
+        return CourseList();
+
+    if (course_list_patch_[student] != kNotPatched)
+    {
+        const auto &row = course_list_patches_[course_list_patch_[student] - 1];
+        return CourseList(row.data(), row.data() + row.size());
+    }
+
+    const CourseHandle *base = course_list_courses_.data();
+    return CourseList(base + course_list_offsets_[student],
+                      base + course_list_offsets_[student + 1]);
+}
+
+ScoreType EnrollmentIndex::Score(CourseHandle course,
+                                 StudentInfo::IDType id) const
+{
+    RosterView roster = Roster(course);
+    std::size_t index = roster.Find(id);
+
+    if (index == roster.size())
+        return kInvalidScore;  // not in this course
+    return roster.scores()[index];
+}
+
+void EnrollmentIndex::SetCredit(CourseHandle course, int credit)
+{
+    if (course >= course_credits_.size())
+        course_credits_.resize(course + 1, 0);
+    int old_credit = course_credits_[course];
+    if (credit == old_credit)
+        return;
+
+    RosterView roster = Roster(course);
+    for (std::size_t index = 0; index < roster.size(); index++)
+    {
+        CountCredit(roster.students()[index], old_credit,
+                    roster.scores()[index], -1);
+        CountCredit(roster.students()[index], credit,
+                    roster.scores()[index], 1);
+    }
+    course_credits_[course] = credit;
+}
+
+void EnrollmentIndex::TakeCreditChanges(std::vector<StudentHandle> &students)
+{
+    for (StudentHandle student : credit_changes_)
+    {
+        students.push_back(student);
+        credit_changed_[student] = false;
+    }
+    credit_changes_.clear();
+}
+
+bool EnrollmentIndex::CheckCredits(std::vector<StudentHandle> *wrong) const
+{
+    std::vector<CreditTotal> totals(
+            std::max(credit_totals_.size(), course_list_patch_.size()),
+            CreditTotal{0, 0});
+    for (CourseHandle course = 0; course < roster_patch_.size(); course++)
+    {
+        RosterView roster = Roster(course);
+        int credit = Credit(course);
+        for (std::size_t index = 0; index < roster.size(); index++)
+        {
+            if (!IsScored(roster.scores()[index]))
+                continue;
+
+            CreditTotal &total = totals[roster.students()[index]];
+            total.weighted_sum += double(roster.scores()[index]) * credit;
+            total.credit += credit;
+        }
+    }
+
+    bool consistent = true;
+    for (StudentHandle student = 0; student < totals.size(); student++)
+    {
+        CreditTotal kept = CreditsOf(student);
+        // the sums are added in another order, so the last bits may differ
+        double tolerance = 1e-9 * std::max(1.0, std::fabs(kept.weighted_sum));
+        if (kept.credit != totals[student].credit ||
+            std::fabs(kept.weighted_sum - totals[student].weighted_sum) >
+                    tolerance)
+        {
+            consistent = false;
+            if (wrong)
+                wrong->push_back(student);
+        }
+    }
+    return consistent;
+}
+
+bool EnrollmentIndex::Enroll(CourseHandle course, StudentHandle student,
+                             StudentInfo::IDType id)
+{
+    RosterView roster = Roster(course);
+    if (roster.Find(id) != roster.size())  // already in
+        return false;
+
+    RosterRow &row = DetachRoster(course);
+    std::size_t pos = std::lower_bound(row.ids.begin(), row.ids.end(), id) -
+                      row.ids.begin();
+    row.ids.insert(row.ids.begin() + pos, id);
+    row.students.insert(row.students.begin() + pos, student);
+    row.scores.insert(row.scores.begin() + pos, kInvalidScore);
+
+    auto &courses = DetachCourseList(student);
+    courses.insert(std::lower_bound(courses.begin(), courses.end(), course),
+                   course);
+
+    delta_size_ += 2;
+    enrollment_num_++;
+    MaybeCompact();
+    return true;
+}
+
+void EnrollmentIndex::EnrollMany(CourseHandle course,
+                                 const std::vector<StudentEntry> &students)
+{
+    if (students.empty())
+        return;
+
+    RosterRow &row = DetachRoster(course);
+    std::size_t old_size = row.ids.size();
+    std::size_t new_size = old_size + students.size();
+    RosterRow merged;
+    merged.ids.reserve(new_size);
+    merged.students.reserve(new_size);
+    merged.scores.reserve(new_size);
+
+    std::size_t old_pos = 0;
+    for (const StudentEntry &student : students)
+    {
+        while (old_pos < old_size && row.ids[old_pos] < student.id)
+        {
+            merged.ids.push_back(row.ids[old_pos]);
+            merged.students.push_back(row.students[old_pos]);
+            merged.scores.push_back(row.scores[old_pos]);
+            old_pos++;
+        }
+        merged.ids.push_back(student.id);
+        merged.students.push_back(student.handle);
+        merged.scores.push_back(kInvalidScore);
+    }
+    merged.ids.insert(merged.ids.end(),
+                      row.ids.begin() + old_pos, row.ids.end());
+    merged.students.insert(merged.students.end(),
+                           row.students.begin() + old_pos, row.students.end());
+    merged.scores.insert(merged.scores.end(),
+                         row.scores.begin() + old_pos, row.scores.end());
+    row = std::move(merged);
+
+    for (const StudentEntry &student : students)
+    {
+        auto &courses = DetachCourseList(student.handle);
+        courses.insert(std::lower_bound(courses.begin(), courses.end(),
+                                        course),
+                       course);
+    }
+
+    delta_size_ += students.size() * 2;
+    enrollment_num_ += students.size();
+    MaybeCompact();
+}
+
+bool EnrollmentIndex::Drop(CourseHandle course, StudentHandle student,
+                           StudentInfo::IDType id)
+{
+    RosterView roster = Roster(course);
+    std::size_t pos = roster.Find(id);
+    if (pos == roster.size())  // not in this course
+        return false;
+
+    CountScore(course, student, Credit(course), roster.scores()[pos], -1);
+    RosterRow &row = DetachRoster(course);
+    row.ids.erase(row.ids.begin() + pos);
+    row.students.erase(row.students.begin() + pos);
+    row.scores.erase(row.scores.begin() + pos);
+
+    auto &courses = DetachCourseList(student);
+    courses.erase(std::lower_bound(courses.begin(), courses.end(), course));
+
+    delta_size_ += 2;
+    enrollment_num_--;
+    MaybeCompact();
+    return true;
+}
+
+bool EnrollmentIndex::SetScore(CourseHandle course, StudentInfo::IDType id,
+                               ScoreType score)
+{
+    RosterView roster = Roster(course);
+    std::size_t index = roster.Find(id);
+    if (index == roster.size())  // not in this course
+        return false;
+
+    int credit = Credit(course);
+    CountScore(course, roster.students()[index], credit,
+               roster.scores()[index], -1);
+    CountScore(course, roster.students()[index], credit, score, 1);
+    RosterForUpdate(course).scores[index] = score;
+    return true;
+}
+
+void EnrollmentIndex::ClearScores(CourseHandle course)
+{
+    MutableRoster roster = RosterForUpdate(course);
+    int credit = Credit(course);
+    for (std::size_t index = 0; index < roster.size; index++)
+        CountScore(course, roster.students[index], credit,
+                   roster.scores[index], -1);
+    std::fill(roster.scores, roster.scores + roster.size, kInvalidScore);
+}
+
+void EnrollmentIndex::MergeScores(
+        CourseHandle course, const FinalScore &scores,
+        std::vector<StudentInfo::IDType> &not_enrolled,
+        std::vector<StudentInfo::IDType> *unscored)
+{
+    MutableRoster roster = RosterForUpdate(course);
+    int credit = Credit(course);
+    std::size_t pos = 0;
+
+    // entries are passed once the next score is beyond them, so theirs is
+    // final by then
+    auto pass = [&roster, &pos, unscored]()
+    {
+        if (unscored && roster.scores[pos] == kInvalidScore)
+            unscored->push_back(roster.ids[pos]);
+        pos++;
+    };
+
+    for (const ScorePiece &score_piece : scores)
+    {
+        while (pos < roster.size && roster.ids[pos] < score_piece.id)
+            pass();
+
+        if (pos < roster.size && roster.ids[pos] == score_piece.id)
+        {
+            CountScore(course, roster.students[pos], credit,
+                       roster.scores[pos], -1);
+            CountScore(course, roster.students[pos], credit,
+                       score_piece.score, 1);
+            roster.scores[pos] = score_piece.score;
+        }
+        else
+            not_enrolled.push_back(score_piece.id);
+    }
+
+    if (unscored)
+    {
+        while (pos < roster.size)
+            pass();
+    }
+}
+
+void EnrollmentIndex::DropStudent(StudentHandle student,
+                                  StudentInfo::IDType id)
+{
+    CourseList list = CoursesOf(student);
+    std::vector<CourseHandle> courses(list.begin(), list.end());
+
+    for (CourseHandle course : courses)
+    {
+        RosterRow &row = DetachRoster(course);
+        std::size_t pos = std::lower_bound(row.ids.begin(), row.ids.end(),
+                                           id) - row.ids.begin();
+        SketchForUpdate(course).Remove(row.scores[pos]);
+        row.ids.erase(row.ids.begin() + pos);
+        row.students.erase(row.students.begin() + pos);
+        row.scores.erase(row.scores.begin() + pos);
+    }
+
+    if (!courses.empty())
+        DetachCourseList(student).clear();
+    ResetCredits(student);
+
+    delta_size_ += courses.size();
+    enrollment_num_ -= courses.size();
+    MaybeCompact();
+}
+
+void EnrollmentIndex::DropCourse(CourseHandle course)
+{
+    RosterView roster = Roster(course);
+    std::vector<StudentHandle> students(roster.students(),
+                                        roster.students() + roster.size());
+    int credit = Credit(course);
+    for (std::size_t index = 0; index < roster.size(); index++)
+        CountScore(course, students[index], credit, roster.scores()[index],
+                   -1);
+
+    for (StudentHandle student : students)
+    {
+        auto &courses = DetachCourseList(student);
+        courses.erase(std::lower_bound(courses.begin(), courses.end(),
+                                       course));
+    }
+
+    if (!students.empty())
+    {
+        RosterRow &row = DetachRoster(course);
+        row.ids.clear();
+        row.students.clear();
+        row.scores.clear();
+    }
+
+    delta_size_ += students.size();
+    enrollment_num_ -= students.size();
+    MaybeCompact();
+}
+
+std::size_t EnrollmentIndex::DropStudents(
+        const std::vector<StudentHandle> &students)
+{
+    std::vector<bool> dropped;
+    std::vector<CourseHandle> courses;
+    std::size_t enrollment_num = 0;
+    for (StudentHandle student : students)
+    {
+        CourseList list = CoursesOf(student);
+        if (list.empty())
+            continue;
+
+        if (dropped.size() <= student)
+            dropped.resize(student + 1, false);
+        dropped[student] = true;
+        courses.insert(courses.end(), list.begin(), list.end());
+        enrollment_num += list.size();
+        DetachCourseList(student).clear();
+        ResetCredits(student);
+    }
+    std::sort(courses.begin(), courses.end());
+    courses.erase(std::unique(courses.begin(), courses.end()), courses.end());
+
+    for (CourseHandle course : courses)
+    {
+        RosterRow &row = DetachRoster(course);
+        std::size_t kept = 0;
+        for (std::size_t index = 0; index < row.ids.size(); index++)
+        {
+            StudentHandle student = row.students[index];
+            if (student < dropped.size() && dropped[student])
+            {
+                SketchForUpdate(course).Remove(row.scores[index]);
+                continue;
+            }
+
+            row.ids[kept] = row.ids[index];
+            row.students[kept] = student;
+            row.scores[kept] = row.scores[index];
+            kept++;
+        }
+        row.ids.resize(kept);
+        row.students.resize(kept);
+        row.scores.resize(kept);
+    }
+
+    delta_size_ += enrollment_num;
+    enrollment_num_ -= enrollment_num;
+    MaybeCompact();
+    return courses.size();
+}
+
+void EnrollmentIndex::RenumberStudents(
+        const std::vector<StudentEntry> &students)
+{
+    std::unordered_map<StudentHandle, StudentInfo::IDType> new_ids;
+    std::vector<CourseHandle> courses;
+    for (const StudentEntry &student : students)
+    {
+        new_ids[student.handle] = student.id;
+        CourseList list = CoursesOf(student.handle);
+        courses.insert(courses.end(), list.begin(), list.end());
+    }
+    std::sort(courses.begin(), courses.end());
+    courses.erase(std::unique(courses.begin(), courses.end()), courses.end());
+
+    struct Entry
+    {
+        StudentInfo::IDType id;
+        StudentHandle student;
+        ScoreType score;
+    };
+    std::vector<Entry> moved;
+
+    // The rows keep their size, so they are rewritten in place: take the
+    // renumbered entries out, sort them and merge them back.
+    for (CourseHandle course : courses)
+    {
+        MutableRoster roster = RosterForUpdate(course);
+        std::size_t kept = 0;
+        moved.clear();
+
+        for (std::size_t index = 0; index < roster.size; index++)
+        {
+            auto iter = new_ids.find(roster.students[index]);
+            if (iter != new_ids.end())
+            {
+                moved.push_back(Entry{iter->second, roster.students[index],
+                                      roster.scores[index]});
+            }
+            else
+            {
+                roster.ids[kept] = roster.ids[index];
+                roster.students[kept] = roster.students[index];
+                roster.scores[kept] = roster.scores[index];
+                kept++;
+            }
+        }
+
+        std::sort(moved.begin(), moved.end(),
+                  [](const Entry &lhs, const Entry &rhs)
+                  { return lhs.id < rhs.id; });
+
+        // merge from the back
+        std::size_t to = roster.size;
+        std::size_t from_moved = moved.size();
+        while (from_moved > 0)
+        {
+            to--;
+            if (kept > 0 && roster.ids[kept - 1] > moved[from_moved - 1].id)
+            {
+                kept--;
+                roster.ids[to] = roster.ids[kept];
+                roster.students[to] = roster.students[kept];
+                roster.scores[to] = roster.scores[kept];
+            }
+            else
+            {
+                from_moved--;
+                roster.ids[to] = moved[from_moved].id;
+                roster.students[to] = moved[from_moved].student;
+                roster.scores[to] = moved[from_moved].score;
+            }
+        }
+    }
+}
+
+void EnrollmentIndex::AddRosters(
+        const std::vector<std::vector<RosterEntry>> &additions)
+{
+    std::size_t course_rows = std::max(roster_patch_.size(), additions.size());
+    std::size_t student_rows = course_list_patch_.size();
+    std::size_t total = enrollment_num_;
+    for (const auto &entries : additions)
+    {
+        total += entries.size();
+        for (const RosterEntry &entry : entries)
+            student_rows = std::max<std::size_t>(student_rows,
+                                                 entry.student + 1);
+    }
+
+    // course -> students, merging the new entries into every row
+    std::vector<std::size_t> roster_offsets(course_rows + 1, 0);
+    std::vector<StudentInfo::IDType> roster_ids;
+    std::vector<StudentHandle> roster_students;
+    std::vector<ScoreType> roster_scores;
+    roster_ids.reserve(total);
+    roster_students.reserve(total);
+    roster_scores.reserve(total);
+
+    static const std::vector<RosterEntry> kNoEntries;
+    for (CourseHandle course = 0; course < course_rows; course++)
+    {
+        RosterView roster = Roster(course);
+        const auto &entries = course < additions.size() ? additions[course]
+                                                        : kNoEntries;
+        if (!entries.empty())
+            NewGeneration(course);
+        int credit = Credit(course);
+        std::size_t old_pos = 0;
+        for (const RosterEntry &entry : entries)
+        {
+            CountScore(course, entry.student, credit, entry.score, 1);
+            for (; old_pos < roster.size() && roster.ids()[old_pos] < entry.id;
+                 old_pos++)
+            {
+                roster_ids.push_back(roster.ids()[old_pos]);
+                roster_students.push_back(roster.students()[old_pos]);
+                roster_scores.push_back(roster.scores()[old_pos]);
+            }
+            roster_ids.push_back(entry.id);
+            roster_students.push_back(entry.student);
+            roster_scores.push_back(entry.score);
+        }
+        roster_ids.insert(roster_ids.end(), roster.ids() + old_pos,
+                          roster.ids() + roster.size());
+        roster_students.insert(roster_students.end(),
+                               roster.students() + old_pos,
+                               roster.students() + roster.size());
+        roster_scores.insert(roster_scores.end(), roster.scores() + old_pos,
+                             roster.scores() + roster.size());
+        roster_offsets[course + 1] = roster_ids.size();
+    }
+
+    // student -> courses, counting sort of the rosters by student. Rows are
+    // visited in course order, so every list comes out sorted.
+    std::vector<std::size_t> course_list_offsets(student_rows + 1, 0);
+    for (StudentHandle student : roster_students)
+        course_list_offsets[student + 1]++;
+    for (std::size_t row = 0; row < student_rows; row++)
+        course_list_offsets[row + 1] += course_list_offsets[row];
+
+    std::vector<CourseHandle> course_list_courses(total);
+    std::vector<std::size_t> fill(course_list_offsets.begin(),
+                                  course_list_offsets.end() - 1);
+    for (CourseHandle course = 0; course < course_rows; course++)
+    {
+        for (std::size_t pos = roster_offsets[course];
+             pos < roster_offsets[course + 1]; pos++)
+        {
+            course_list_courses[fill[roster_students[pos]]++] = course;
+        }
+    }
+
+    roster_offsets_.swap(roster_offsets);
+    roster_ids_.swap(roster_ids);
+    roster_students_.swap(roster_students);
+    roster_scores_.swap(roster_scores);
+    course_list_offsets_.swap(course_list_offsets);
+    course_list_courses_.swap(course_list_courses);
+
+    roster_patch_.assign(course_rows, kNotPatched);
+    roster_patches_.clear();
+    course_list_patch_.assign(student_rows, kNotPatched);
+    course_list_patches_.clear();
+    delta_size_ = 0;
+    enrollment_num_ = total;
+}
+
+void EnrollmentIndex::Compact()
+{
+    if (delta_size_ == 0)
+        return;
+
+    // course -> students
+    std::size_t course_rows = roster_patch_.size();
+    std::vector<std::size_t> roster_offsets(course_rows + 1, 0);
+    std::vector<StudentInfo::IDType> roster_ids;
+    std::vector<StudentHandle> roster_students;
+    std::vector<ScoreType> roster_scores;
+    roster_ids.reserve(enrollment_num_);
+    roster_students.reserve(enrollment_num_);
+    roster_scores.reserve(enrollment_num_);
+
+    for (CourseHandle course = 0; course < course_rows; course++)
+    {
+        RosterView roster = Roster(course);
+        roster_ids.insert(roster_ids.end(),
+                          roster.ids(), roster.ids() + roster.size());
+        roster_students.insert(roster_students.end(), roster.students(),
+                               roster.students() + roster.size());
+        roster_scores.insert(roster_scores.end(),
+                             roster.scores(), roster.scores() + roster.size());
+        roster_offsets[course + 1] = roster_ids.size();
+    }
+
+    // student -> courses
+    std::size_t student_rows = course_list_patch_.size();
+    std::vector<std::size_t> course_list_offsets(student_rows + 1, 0);
+    std::vector<CourseHandle> course_list_courses;
+    course_list_courses.reserve(enrollment_num_);
+
+    for (StudentHandle student = 0; student < student_rows; student++)
+    {
+        CourseList courses = CoursesOf(student);
+        course_list_courses.insert(course_list_courses.end(),
+                                   courses.begin(), courses.end());
+        course_list_offsets[student + 1] = course_list_courses.size();
+    }
+
+    roster_offsets_.swap(roster_offsets);
+    roster_ids_.swap(roster_ids);
+    roster_students_.swap(roster_students);
+    roster_scores_.swap(roster_scores);
+    course_list_offsets_.swap(course_list_offsets);
+    course_list_courses_.swap(course_list_courses);
+
+    std::fill(roster_patch_.begin(), roster_patch_.end(), kNotPatched);
+    roster_patches_.clear();
+    std::fill(course_list_patch_.begin(), course_list_patch_.end(),
+              kNotPatched);
+    course_list_patches_.clear();
+    delta_size_ = 0;
+}
+
+void EnrollmentIndex::Clear()
+{
+    // generations go on, courses may still hold what they have worked out,
+    // the courses keep their credits, the sketches their resolution, and
+    // the students who had credits are noted as changed
+    std::uint64_t last_generation = last_generation_;
+    double sketch_resolution = empty_sketch_.resolution();
+    std::vector<int> course_credits;
+    course_credits.swap(course_credits_);
+    std::vector<StudentHandle> credit_changes;
+    TakeCreditChanges(credit_changes);
+    for (StudentHandle student = 0; student < credit_totals_.size(); student++)
+    {
+        if (credit_totals_[student].credit != 0)
+            credit_changes.push_back(student);
+    }
+
+    *this = EnrollmentIndex();
+    last_generation_ = last_generation;
+    course_credits_.swap(course_credits);
+    empty_sketch_ = ScoreSketch(sketch_resolution);
+    for (StudentHandle student : credit_changes)
+        NoteCreditChange(student);
+}
+
+void EnrollmentIndex::SetSketchResolution(double resolution)
+{
+    empty_sketch_ = ScoreSketch(resolution);
+    sketches_.assign(roster_patch_.size(), empty_sketch_);
+    for (CourseHandle course = 0; course < sketches_.size(); course++)
+    {
+        RosterView roster = Roster(course);
+        for (std::size_t index = 0; index < roster.size(); index++)
+            sketches_[course].Add(roster.scores()[index]);
+    }
+}
+
+void EnrollmentIndex::CountScore(CourseHandle course, StudentHandle student,
+                                 int credit, ScoreType score, int sign)
+{
+    if (!IsScored(score))
+        return;
+
+    if (sign > 0)
+        SketchForUpdate(course).Add(score);
+    else
+        SketchForUpdate(course).Remove(score);
+    CountCredit(student, credit, score, sign);
+}
+
+void EnrollmentIndex::CountCredit(StudentHandle student, int credit,
+                                  ScoreType score, int sign)
+{
+    if (!IsScored(score))
+        return;
+
+    if (student >= credit_totals_.size())
+        credit_totals_.resize(student + 1, CreditTotal{0, 0});
+    CreditTotal &total = credit_totals_[student];
+    total.weighted_sum += sign * (double(score) * credit);
+    total.credit += sign * credit;
+    NoteCreditChange(student);
+}
+
+ScoreSketch & EnrollmentIndex::SketchForUpdate(CourseHandle course)
+{
+    if (course >= sketches_.size())
+        sketches_.resize(course + 1, empty_sketch_);
+    return sketches_[course];
+}
+
+void EnrollmentIndex::ResetCredits(StudentHandle student)
+{
+    if (student < credit_totals_.size())
+    {
+        credit_totals_[student] = CreditTotal{0, 0};
+        NoteCreditChange(student);
+    }
+}
+
+void EnrollmentIndex::NoteCreditChange(StudentHandle student)
+{
+    if (student >= credit_changed_.size())
+        credit_changed_.resize(student + 1, false);
+    if (!credit_changed_[student])
+    {
+        credit_changed_[student] = true;
+        credit_changes_.push_back(student);
+    }
+}
+
+EnrollmentIndex::MutableRoster EnrollmentIndex::RosterForUpdate(
+        CourseHandle course)
+{
+    if (course >= roster_patch_.size())
+        return MutableRoster{nullptr, nullptr, nullptr, 0};
+
+    NewGeneration(course);
+    if (roster_patch_[course] != kNotPatched)
+    {
+        RosterRow &row = roster_patches_[roster_patch_[course] - 1];
+        return MutableRoster{row.ids.data(), row.students.data(),
+                             row.scores.data(), row.ids.size()};
+    }
+
+    std::size_t begin = roster_offsets_[course];
+    return MutableRoster{roster_ids_.data() + begin,
+                         roster_students_.data() + begin,
+                         roster_scores_.data() + begin,
+                         roster_offsets_[course + 1] - begin};
+}
+
+EnrollmentIndex::RosterRow & EnrollmentIndex::DetachRoster(
+        CourseHandle course)
+{
+    if (course >= roster_patch_.size())  // a new row
+    {
+        roster_patch_.resize(course + 1, kNotPatched);
+        roster_offsets_.resize(course + 2, roster_offsets_.back());
+    }
+
+    NewGeneration(course);
+    if (roster_patch_[course] == kNotPatched)
+    {
+        RosterView roster = Roster(course);
+        RosterRow row;
+        row.ids.assign(roster.ids(), roster.ids() + roster.size());
+        row.students.assign(roster.students(),
+                            roster.students() + roster.size());
+        row.scores.assign(roster.scores(), roster.scores() + roster.size());
+
+        roster_patches_.push_back(std::move(row));
+        roster_patch_[course] = roster_patches_.size();
+        delta_size_ += roster.size();
+    }
+
+    return roster_patches_[roster_patch_[course] - 1];
+}
+
+void EnrollmentIndex::NewGeneration(CourseHandle course)
+{
+    if (course >= roster_generations_.size())
+        roster_generations_.resize(course + 1, 0);
+    roster_generations_[course] = ++last_generation_;
+}
+
+std::vector<CourseHandle> & EnrollmentIndex::DetachCourseList(
+        StudentHandle student)
+{
+    if (student >= course_list_patch_.size())  // a new row
+    {
+        course_list_patch_.resize(student + 1, kNotPatched);
+        course_list_offsets_.resize(student + 2, course_list_offsets_.back());
+    }
+
+    if (course_list_patch_[student] == kNotPatched)
+    {
+        CourseList courses = CoursesOf(student);
+        course_list_patches_.emplace_back(courses.begin(), courses.end());
+        course_list_patch_[student] = course_list_patches_.size();
+        delta_size_ += courses.size();
+    }
+
+    return course_list_patches_[course_list_patch_[student] - 1];
+}
+
+void EnrollmentIndex::MaybeCompact()
+{
+    // Keep the delta small compared with the compressed arrays, so that the
+    // cost of rebuilding is spread over many edits.
+    if (delta_size_ > roster_ids_.size() / 2 + kMinDeltaSize)
+        Compact();
+}
+
+}  // namespace SAM
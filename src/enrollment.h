@@ -0,0 +1,292 @@
+#ifndef SAM_ENROLLMENT_H_
+#define SAM_ENROLLMENT_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include <iterator>
+#include <vector>
+
+#include "common.h"
+#include "score_sketch.h"
+
+namespace SAM {
+
+// Read-only view of a course roster, sorted by student ID.
+// IDs, student handles and scores are kept in separate contiguous arrays.
+// Invalidated when students are added to or removed from any course.
+class RosterView
+{
+ public:
+    class Iterator
+            : public std::iterator<std::forward_iterator_tag, ScorePiece,
+                                   std::ptrdiff_t, const ScorePiece *,
+                                   ScorePiece>
+    {
+     public:
+        Iterator(const RosterView *roster, std::size_t index)
+                : roster_(roster), index_(index) {}
+
+        bool operator==(const Iterator &rhs) const
+        { return index_ == rhs.index_; }
+        bool operator!=(const Iterator &rhs) const
+        { return index_ != rhs.index_; }
+
+        ScorePiece operator*() const { return (*roster_)[index_]; }
+
+        Iterator & operator++()
+        {
+            ++index_;
+            return *this;
+        }
+
+        Iterator operator++(int)
+        {
+            return Iterator(roster_, index_++);
+        }
+
+     private:
+        const RosterView *roster_;
+        std::size_t index_;
+    };
+
+    RosterView() : ids_(nullptr), students_(nullptr), scores_(nullptr),
+                   size_(0) {}
+    RosterView(const StudentInfo::IDType *ids, const StudentHandle *students,
+               const ScoreType *scores, std::size_t size)
+            : ids_(ids), students_(students), scores_(scores), size_(size) {}
+
+    std::size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    const StudentInfo::IDType * ids() const { return ids_; }
+    const StudentHandle * students() const { return students_; }
+    const ScoreType * scores() const { return scores_; }
+
+    ScorePiece operator[](std::size_t index) const
+    { return ScorePiece{ids_[index], scores_[index]}; }
+
+    // Return size() if not found
+    std::size_t Find(StudentInfo::IDType id) const;
+
+    Iterator begin() const { return Iterator(this, 0); }
+    Iterator end() const { return Iterator(this, size_); }
+
+ private:
+    const StudentInfo::IDType *ids_;
+    const StudentHandle *students_;
+    const ScoreType *scores_;
+    std::size_t size_;
+};
+
+// Read-only view of the courses a student takes, sorted by handle.
+class CourseList
+{
+ public:
+    CourseList() : begin_(nullptr), end_(nullptr) {}
+    CourseList(const CourseHandle *begin, const CourseHandle *end)
+            : begin_(begin), end_(end) {}
+
+    const CourseHandle * begin() const { return begin_; }
+    const CourseHandle * end() const { return end_; }
+    std::size_t size() const { return end_ - begin_; }
+    bool empty() const { return begin_ == end_; }
+
+    bool Contains(CourseHandle course) const;
+
+ private:
+    const CourseHandle *begin_;
+    const CourseHandle *end_;
+};
+
+// Who takes which course, in both directions, as compressed sparse rows:
+// course -> (student ID, student handle, score) and student -> course handle.
+// Rows are indexed by handle.
+//
+// Scores are changed in place. Adding or removing students copies the rows
+// involved into a delta buffer, which is folded back into the compressed
+// arrays by Compact(), either explicitly (after loading) or when the delta
+// grows too large.
+//
+// Every change to a roster gives it a new generation, so that what has
+// been worked out from it can be kept until then.
+//
+// The credits of every student and a sketch of the scores of every course
+// are kept up to date as well: each change adds or takes away only the
+// (course, student) pairs it touches.
+class EnrollmentIndex
+{
+ public:
+    // Of the courses a student has a valid score in
+    struct CreditTotal
+    {
+        double weighted_sum;  // score * credit
+        int credit;
+    };
+
+    struct StudentEntry
+    {
+        StudentInfo::IDType id;
+        StudentHandle handle;
+    };
+
+    struct RosterEntry
+    {
+        StudentInfo::IDType id;
+        StudentHandle student;
+        ScoreType score;
+    };
+
+    EnrollmentIndex();
+
+    RosterView Roster(CourseHandle course) const;
+    CourseList CoursesOf(StudentHandle student) const;
+    std::size_t RosterSize(CourseHandle course) const
+    { return Roster(course).size(); }
+    std::size_t EnrollmentNumber() const { return enrollment_num_; }
+    // Changes (never back) whenever the students or scores of the course
+    // may have changed, 0 if they never have
+    std::uint64_t RosterGeneration(CourseHandle course) const
+    {
+        return course < roster_generations_.size() ?
+                   roster_generations_[course] : 0;
+    }
+
+    // If the student is not in this course, kInvalidScore will be returned.
+    ScoreType Score(CourseHandle course, StudentInfo::IDType id) const;
+
+    CreditTotal CreditsOf(StudentHandle student) const
+    {
+        return student < credit_totals_.size() ? credit_totals_[student]
+                                               : CreditTotal{0, 0};
+    }
+    int Credit(CourseHandle course) const
+    { return course < course_credits_.size() ? course_credits_[course] : 0; }
+    // The students of the course are updated, one by one
+    void SetCredit(CourseHandle course, int credit);
+    // Add the students whose credits may have changed since the last call
+    // to the back of students, each once
+    void TakeCreditChanges(std::vector<StudentHandle> &students);
+    // Work the credits of every student out again from the rosters.
+    // Return false if any of them differs from what has been kept, and add
+    // the students to the back of wrong if given.
+    bool CheckCredits(std::vector<StudentHandle> *wrong = nullptr) const;
+
+    const ScoreSketch & Sketch(CourseHandle course) const
+    { return course < sketches_.size() ? sketches_[course] : empty_sketch_; }
+    double sketch_resolution() const { return empty_sketch_.resolution(); }
+    // Every sketch is built again from the rosters
+    void SetSketchResolution(double resolution);
+
+    // Return false if the student has already been in the course
+    bool Enroll(CourseHandle course, StudentHandle student,
+                StudentInfo::IDType id);
+    // Merge students into a roster in one pass.
+    // students shall be sorted by ID, and none of them in the course.
+    void EnrollMany(CourseHandle course,
+                    const std::vector<StudentEntry> &students);
+    // Return false if the student is not in the course
+    bool Drop(CourseHandle course, StudentHandle student,
+              StudentInfo::IDType id);
+    // Return false if the student is not in the course
+    bool SetScore(CourseHandle course, StudentInfo::IDType id,
+                  ScoreType score);
+    void ClearScores(CourseHandle course);
+    // Set many scores in one pass along the roster.
+    // scores shall be sorted by ID without duplicates. IDs not in the course
+    // will be added to the back of not_enrolled. If unscored is given, the
+    // same pass adds the IDs left with kInvalidScore to its back.
+    void MergeScores(CourseHandle course, const FinalScore &scores,
+                     std::vector<StudentInfo::IDType> &not_enrolled,
+                     std::vector<StudentInfo::IDType> *unscored = nullptr);
+
+    // Remove a student/course from every row it appears in
+    void DropStudent(StudentHandle student, StudentInfo::IDType id);
+    void DropCourse(CourseHandle course);
+    // Remove many students at once, every roster involved is filtered in one
+    // pass. Return the number of rosters changed.
+    std::size_t DropStudents(const std::vector<StudentHandle> &students);
+    // Give students new IDs (entry.id) in every roster at once.
+    // Only the rosters of their courses are touched, each in one pass.
+    void RenumberStudents(const std::vector<StudentEntry> &students);
+
+    // Add students to many courses and rebuild the compressed arrays in one
+    // pass. additions[c] holds the students for course c, sorted by ID and
+    // none of them in the course yet. The student -> course rows are
+    // rebuilt from the rosters by counting, so no delta is left behind.
+    void AddRosters(const std::vector<std::vector<RosterEntry>> &additions);
+
+    // Fold the delta buffer into the compressed arrays
+    void Compact();
+    void Clear();
+
+ private:
+    // A row that has been modified since the last Compact()
+    struct RosterRow
+    {
+        std::vector<StudentInfo::IDType> ids;
+        std::vector<StudentHandle> students;
+        std::vector<ScoreType> scores;
+    };
+
+    struct MutableRoster
+    {
+        StudentInfo::IDType *ids;
+        StudentHandle *students;
+        ScoreType *scores;
+        std::size_t size;
+    };
+
+    static const std::uint32_t kNotPatched = 0;
+    static const std::size_t kMinDeltaSize = 4096;
+
+    // Add (sign 1) or take away (sign -1) a score of the student in the
+    // course, to the credits and to the sketch
+    void CountScore(CourseHandle course, StudentHandle student, int credit,
+                    ScoreType score, int sign);
+    void CountCredit(StudentHandle student, int credit, ScoreType score,
+                     int sign);
+    ScoreSketch & SketchForUpdate(CourseHandle course);
+    void ResetCredits(StudentHandle student);
+    void NoteCreditChange(StudentHandle student);
+
+    MutableRoster RosterForUpdate(CourseHandle course);
+    RosterRow & DetachRoster(CourseHandle course);
+    void NewGeneration(CourseHandle course);
+    std::vector<CourseHandle> & DetachCourseList(StudentHandle student);
+    void MaybeCompact();
+
+    // course -> students
+    std::vector<std::size_t> roster_offsets_;  // one more than rows
+    std::vector<StudentInfo::IDType> roster_ids_;
+    std::vector<StudentHandle> roster_students_;
+    std::vector<ScoreType> roster_scores_;
+
+    // student -> courses
+    std::vector<std::size_t> course_list_offsets_;  // one more than rows
+    std::vector<CourseHandle> course_list_courses_;
+
+    // delta buffer, rows point into it with (index + 1)
+    std::vector<std::uint32_t> roster_patch_;
+    std::vector<RosterRow> roster_patches_;
+    std::vector<std::uint32_t> course_list_patch_;
+    std::vector<std::vector<CourseHandle>> course_list_patches_;
+    std::size_t delta_size_;
+
+    std::size_t enrollment_num_;
+
+    std::vector<int> course_credits_;
+    std::vector<CreditTotal> credit_totals_;  // by student
+    std::vector<StudentHandle> credit_changes_;
+    std::vector<bool> credit_changed_;  // by student, in credit_changes_
+
+    std::vector<ScoreSketch> sketches_;  // by course
+    ScoreSketch empty_sketch_;  // of the resolution of every sketch
+
+    std::vector<std::uint64_t> roster_generations_;
+    std::uint64_t last_generation_;  // shared by the rows
+};
+
+}  // namespace SAM
+
+#endif  // SAM_ENROLLMENT_H_
@@ -0,0 +1,129 @@
+#include <cmath>
+#include <limits>
+
+#include "gpa_ranking.h"
+
+namespace SAM {
+
+const int GpaRanking::kAllDepartments;
+
+GpaRanking::GpaRanking() : all_(), departments_(), slots_()
+{
+}
+
+void GpaRanking::Update(StudentHandle student, StudentInfo::IDType id,
+                        int department, ScoreType gpa)
+{
+    if (student < slots_.size() && slots_[student].ranked)
+    {
+        const Slot &slot = slots_[student];
+        if (slot.key.gpa == gpa && slot.key.id == id &&
+            slot.department == department)
+            return;  // nothing has changed
+    }
+
+    Remove(student);
+    if (gpa == kInvalidScore || gpa != gpa)
+        return;
+
+    if (student >= slots_.size())
+        slots_.resize(student + 1, Slot{Key{0, 0}, 0, false});
+    slots_[student] = Slot{Key{gpa, id}, department, true};
+    all_.Insert(slots_[student].key);
+    departments_[department].Insert(slots_[student].key);
+}
+
+void GpaRanking::Remove(StudentHandle student)
+{
+    if (student >= slots_.size() || !slots_[student].ranked)
+        return;
+
+    Slot &slot = slots_[student];
+    all_.Erase(slot.key);
+    auto iter = departments_.find(slot.department);
+    iter->second.Erase(slot.key);
+    if (iter->second.empty())
+        departments_.erase(iter);
+    slot.ranked = false;
+}
+
+void GpaRanking::Clear()
+{
+    all_.Clear();
+    departments_.clear();
+    slots_.clear();
+}
+
+std::size_t GpaRanking::size(int department) const
+{
+    const Tree *tree = TreeOf(department);
+    return tree ? tree->size() : 0;
+}
+
+void GpaRanking::Top(std::size_t k, int department,
+                     std::vector<Entry> &entries) const
+{
+    const Tree *tree = TreeOf(department);
+    if (!tree)
+        return;
+
+    for (std::size_t index = 0; index < k && index < tree->size(); index++)
+    {
+        const Key &key = tree->Select(index);
+        std::size_t rank = index + 1;
+        if (index != 0 && entries.back().gpa == key.gpa)  // a tie
+            rank = entries.back().rank;
+        entries.push_back(Entry{key.id, key.gpa, rank});
+    }
+}
+
+bool GpaRanking::Find(StudentHandle student, bool in_department,
+                      Entry &entry) const
+{
+    if (student >= slots_.size() || !slots_[student].ranked)
+        return false;
+
+    const Slot &slot = slots_[student];
+    const Tree &tree = in_department ? *TreeOf(slot.department) : all_;
+    entry = Entry{slot.key.id, slot.key.gpa, RankOf(tree, slot.key.gpa)};
+    return true;
+}
+
+double GpaRanking::Percentile(StudentHandle student, bool in_department) const
+{
+    if (student >= slots_.size() || !slots_[student].ranked)
+        return 0;
+
+    const Slot &slot = slots_[student];
+    const Tree &tree = in_department ? *TreeOf(slot.department) : all_;
+    // those with the same GPA or better come first, whatever their IDs
+    std::size_t not_lower = tree.CountNotAfter(
+            Key{slot.key.gpa, std::numeric_limits<StudentInfo::IDType>::max()});
+    return 100.0 * (tree.size() - not_lower) / tree.size();
+}
+
+ScoreType GpaRanking::Cutoff(double percent, int department) const
+{
+    const Tree *tree = TreeOf(department);
+    if (!tree || tree->empty())
+        return kInvalidScore;
+
+    double count = std::ceil(tree->size() * percent / 100);
+    std::size_t index = 0;
+    if (count > tree->size())
+        index = tree->size() - 1;
+    else if (count > 1)
+        index = static_cast<std::size_t>(count) - 1;
+    return tree->Select(index).gpa;
+}
+
+const GpaRanking::Tree * GpaRanking::TreeOf(int department) const
+{
+    if (department == kAllDepartments)
+        return &all_;
+
+    auto iter = departments_.find(department);
+    return iter != departments_.end() ? &iter->second : nullptr;
+}
+
+}  // namespace SAM
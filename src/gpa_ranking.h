@@ -0,0 +1,89 @@
+#ifndef SAM_GPA_RANKING_H_
+#define SAM_GPA_RANKING_H_
+
+#include <cstddef>
+
+#include <map>
+#include <vector>
+
+#include "common.h"
+#include "rank_tree.h"
+
+namespace SAM {
+
+// Students ranked by GPA, best first, across the university and within each
+// department. Students without a GPA are not ranked. Students with the same
+// GPA share a rank and are listed by ID.
+// Every query takes O(log n), Top() O(log n) per student.
+// Kept by the Manager, see Manager::Ranking().
+class GpaRanking
+{
+ public:
+    static const int kAllDepartments = -1;
+
+    struct Entry
+    {
+        StudentInfo::IDType id;
+        ScoreType gpa;
+        std::size_t rank;  // 1 + the number of students with a higher GPA
+    };
+
+    GpaRanking();
+
+    // Put the student at gpa, or take him out if gpa is kInvalidScore
+    void Update(StudentHandle student, StudentInfo::IDType id, int department,
+                ScoreType gpa);
+    void Remove(StudentHandle student);
+    void Clear();
+
+    // number of students ranked
+    std::size_t size(int department = kAllDepartments) const;
+
+    // The best k students, added to the back of entries
+    void Top(std::size_t k, int department, std::vector<Entry> &entries) const;
+    // Return false if the student is not ranked
+    bool Find(StudentHandle student, bool in_department, Entry &entry) const;
+    // Percentage of the students ranked with a lower GPA, 0 if the student
+    // is not ranked
+    double Percentile(StudentHandle student, bool in_department) const;
+    // The GPA needed to be among the best percent% (0, 100] of the students,
+    // kInvalidScore if no student is ranked
+    ScoreType Cutoff(double percent, int department) const;
+
+ private:
+    struct Key
+    {
+        ScoreType gpa;
+        StudentInfo::IDType id;
+    };
+
+    struct ByGpa
+    {
+        bool operator()(const Key &lhs, const Key &rhs) const
+        {
+            return lhs.gpa > rhs.gpa || (lhs.gpa == rhs.gpa && lhs.id < rhs.id);
+        }
+    };
+
+    typedef RankTree<Key, ByGpa> Tree;
+
+    struct Slot
+    {
+        Key key;
+        int department;
+        bool ranked;
+    };
+
+    // nullptr if no student of the department is ranked
+    const Tree * TreeOf(int department) const;
+    std::size_t RankOf(const Tree &tree, ScoreType gpa) const
+    { return 1 + tree.CountBefore(Key{gpa, 0}); }
+
+    Tree all_;
+    std::map<int, Tree> departments_;
+    std::vector<Slot> slots_;  // by student handle
+};
+
+}  // namespace SAM
+
+#endif  // SAM_GPA_RANKING_H_
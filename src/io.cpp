@@ -1,51 +1,360 @@
+#include <cstring>
+
+#include <algorithm>
+#include <atomic>
 #include <fstream>
 #include <sstream>
+
+#if !defined(_WIN32) && (defined(__unix__) || defined(__unix) || (defined(__APPLE__) && defined(__MACH__)))
+
+#ifndef UNIX_LIKE_SYS
+#define UNIX_LIKE_SYS
+#endif
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#endif
+
+#include "atomic_file.h"
 #include "io.h"
+#include "mutation_log.h"
+#include "text_parser.h"
 
 namespace SAM {
 
-bool ManagerReader::Read(const std::string &student_file_name,
-                         const std::string &course_file_name,
-                         Manager &manager)
-{
-    std::ifstream student_fin(student_file_name);
-    std::ifstream course_fin(course_file_name);
+namespace {
 
-    if (!student_fin.is_open() || !course_fin.is_open())
+bool ReadWholeFile(const std::string &file_name, std::string &content)
+{
+    std::ifstream fin(file_name, std::ios::binary);
+    if (!fin.is_open())
         return false;
 
-    // read students
-    std::string line;
-    while (std::getline(student_fin, line))
+    std::ostringstream oss;
+    oss << fin.rdbuf();
+    content = oss.str();
+    return true;
+}
+
+// Below this, a file is not worth splitting
+const std::size_t kMinChunkSize = 1 << 20;
+
+// What a worker has parsed from its part of a file. error.line counts from
+// the beginning of the chunk.
+struct StudentChunk
+{
+    std::vector<StudentInfo> students;
+    std::size_t line_num;
+    ParseError error;
+};
+
+struct CourseRecord
+{
+    CourseInfo info;
+    FinalScore roster;
+};
+
+struct CourseChunk
+{
+    std::vector<CourseRecord> courses;
+    std::size_t line_num;
+    ParseError error;
+};
+
+std::size_t ChunkNumFor(std::size_t size, unsigned thread_num)
+{
+    std::size_t chunk_num = size / kMinChunkSize + 1;
+    return std::min<std::size_t>(chunk_num, thread_num);
+}
+
+// Split text into chunk_num pieces of about the same size, each ending
+// right after a line break. Return the chunk_num + 1 boundaries.
+std::vector<const char *> SplitAtLines(const std::string &text,
+                                       std::size_t chunk_num)
+{
+    const char *begin = text.data();
+    const char *end = begin + text.size();
+    std::vector<const char *> bounds(1, begin);
+
+    for (std::size_t index = 1; index < chunk_num; index++)
+    {
+        const char *target = begin + text.size() * index / chunk_num;
+        if (target < bounds.back())
+            target = bounds.back();
+
+        const char *newline = static_cast<const char *>(
+                std::memchr(target, '\n', end - target));
+        bounds.push_back(newline ? newline + 1 : end);
+    }
+    bounds.push_back(end);
+    return bounds;
+}
+
+// Courses take two lines each (the info line, then the roster line, which
+// may be empty), so the line breaks to split at can only be found by
+// walking the lines from the beginning. Only line starts are looked at.
+std::vector<const char *> SplitAtCourses(const std::string &text,
+                                         std::size_t chunk_num)
+{
+    const char *begin = text.data();
+    std::vector<const char *> bounds(1, begin);
+
+    TextParser parser(text);
+    std::size_t next_target = text.size() / chunk_num;
+    while (bounds.size() < chunk_num && parser.NextNonBlankLine())
+    {
+        const char *record = parser.line_begin();
+        if (static_cast<std::size_t>(record - begin) >= next_target)
+        {
+            bounds.push_back(record);
+            next_target = text.size() * bounds.size() / chunk_num;
+        }
+        parser.NextLine();  // the roster line
+    }
+    bounds.push_back(begin + text.size());
+    return bounds;
+}
+
+void ParseStudents(const char *begin, const char *end, StudentChunk &chunk)
+{
+    TextParser parser(begin, end);
+    chunk.error = ParseError{0, 0, std::string()};
+
+    while (parser.NextNonBlankLine())
     {
         StudentInfo info;
-        MakeStudentInfo(line, info);
-        manager.AddStudent(info);
+        if (!parser.ReadStudentInfo(info) || !parser.ExpectLineEnd())
+        {
+            chunk.error = parser.error();
+            break;
+        }
+        chunk.students.push_back(info);
     }
-    student_fin.close();
+    chunk.line_num = parser.line();
+}
+
+void ParseCourses(const char *begin, const char *end, CourseChunk &chunk)
+{
+    TextParser parser(begin, end);
+    chunk.error = ParseError{0, 0, std::string()};
 
-    // read courses
-    while (std::getline(course_fin, line))
+    while (parser.NextNonBlankLine())
     {
-        CourseInfo course_info;
-        MakeCourseInfo(line, course_info);
-        manager.AddCourse(course_info);
+        CourseRecord record;
+        if (!parser.ReadCourseInfo(record.info) || !parser.ExpectLineEnd())
+        {
+            chunk.error = parser.error();
+            break;
+        }
 
         // recover student info
-        if (!std::getline(course_fin, line))
+        if (!parser.NextLine())
+        {
+            parser.Fail("student list");
+            chunk.error = parser.error();
+            break;
+        }
+
+        ScorePiece piece;
+        while (!parser.AtLineEnd())
+        {
+            if (!parser.ReadUInt64("student ID", piece.id) ||
+                !parser.ReadScore("score", piece.score))
+                break;
+            record.roster.push_back(piece);
+        }
+        if (parser.error().line != 0)
+        {
+            chunk.error = parser.error();
+            break;
+        }
+
+        chunk.courses.push_back(std::move(record));
+    }
+    chunk.line_num = parser.line();
+}
+
+// Pairs of student ID and score, in any number of lines
+bool ParseFinalScore(const std::string &text, FinalScore &final_score,
+                     ParseError &error)
+{
+    TextParser parser(text);
+    ScorePiece score_piece;
+
+    while (parser.NextLine())
+    {
+        while (!parser.AtLineEnd())
+        {
+            if (!parser.ReadUInt64("student ID", score_piece.id) ||
+                !parser.ReadScore("score", score_piece.score))
+            {
+                error = parser.error();
+                return false;
+            }
+            final_score.push_back(score_piece);
+        }
+    }
+    return true;
+}
+
+// The files a final score import names, see ReadFinalScores()
+bool ListFinalScoreFiles(const std::string &path,
+                         std::vector<FinalScoreFile> &files,
+                         ParseError &error)
+{
+#ifdef UNIX_LIKE_SYS
+    struct stat path_stat;
+    if (::stat(path.c_str(), &path_stat) == 0 && S_ISDIR(path_stat.st_mode))
+    {
+        DIR *dir = ::opendir(path.c_str());
+        if (dir == nullptr)
             return false;
 
-        std::istringstream iss(line);
-        Student::IDType student_id;
-        ScoreType score;
+        static const char kSuffix[] = ".txt";
+        const std::size_t suffix_size = sizeof(kSuffix) - 1;
+        std::vector<std::string> names;
+        while (const struct dirent *entry = ::readdir(dir))
+        {
+            std::string name(entry->d_name);
+            if (name.size() > suffix_size && name[0] != '.' &&
+                name.compare(name.size() - suffix_size, suffix_size,
+                             kSuffix) == 0)
+                names.push_back(name);
+        }
+        ::closedir(dir);
 
-        while (iss >> student_id >> score)
+        std::sort(names.begin(), names.end());
+        for (const std::string &name : names)
         {
-            manager.AddStudentToCourse(student_id, course_info.id);
-            manager.ChangeScore(student_id, course_info.id, score);
+            files.push_back(FinalScoreFile());
+            files.back().course_id = name.substr(0, name.size() - suffix_size);
+            files.back().file_name = path + '/' + name;
         }
+        return true;
     }
+#endif
+
+    std::string text;
+    if (!ReadWholeFile(path, text))
+        return false;
 
+    std::string directory = path.substr(0, path.rfind('/') + 1);
+    TextParser parser(text);
+    while (parser.NextNonBlankLine())
+    {
+        FinalScoreFile file;
+        if (!parser.ReadString("course ID", file.course_id) ||
+            !parser.ReadString("file name", file.file_name) ||
+            !parser.ExpectLineEnd())
+        {
+            error = parser.error();
+            return false;
+        }
+
+        if (file.file_name[0] != '/')
+            file.file_name.insert(0, directory);
+        files.push_back(std::move(file));
+    }
+    return true;
+}
+
+// Run parse(bounds[i], bounds[i + 1], chunks[i]) for every chunk, the
+// first one on this thread
+template <typename Chunk, typename Parse>
+void ParseChunks(const std::vector<const char *> &bounds,
+                 std::vector<Chunk> &chunks, Parse parse)
+{
+    chunks.resize(bounds.size() - 1);
+    RunOnThreads(static_cast<unsigned>(chunks.size()),
+                 [&bounds, &chunks, &parse](unsigned index)
+                 {
+                     parse(bounds[index], bounds[index + 1], chunks[index]);
+                 });
+}
+
+// Return false if any chunk has an error, the first one of the file
+// (with its line counted from the start of the file) in error
+template <typename Chunk>
+bool FirstError(const std::vector<Chunk> &chunks, ParseError &error)
+{
+    std::size_t line_num = 0;
+    for (const Chunk &chunk : chunks)
+    {
+        if (chunk.error.line != 0)
+        {
+            error = chunk.error;
+            error.line += line_num;
+            return false;
+        }
+        line_num += chunk.line_num;
+    }
+    return true;
+}
+
+}  // namespace
+
+ManagerReader::ManagerReader()
+        : error_{0, 0, std::string()}
+{
+}
+
+bool ManagerReader::Read(const std::string &student_file_name,
+                         const std::string &course_file_name,
+                         Manager &manager)
+{
+    std::string student_text, course_text;
+    error_ = ParseError{0, 0, std::string()};
+
+    if (!ReadWholeFile(student_file_name, student_text) ||
+        !ReadWholeFile(course_file_name, course_text))
+        return false;
+
+    // Parse both files in chunks on worker threads, then add the results in
+    // file order, so that the outcome is the same as reading line by line.
+    std::vector<StudentChunk> student_chunks;
+    ParseChunks(SplitAtLines(student_text,
+                             ChunkNumFor(student_text.size(), thread_num_)),
+                student_chunks, ParseStudents);
+
+    std::vector<CourseChunk> course_chunks;
+    ParseChunks(SplitAtCourses(course_text,
+                               ChunkNumFor(course_text.size(), thread_num_)),
+                course_chunks, ParseCourses);
+
+    // Everything has been parsed, so a malformed record is found before the
+    // manager is touched: it is read all or nothing.
+    if (!FirstError(student_chunks, error_) ||
+        !FirstError(course_chunks, error_))
+        return false;
+
+    // read students
+    std::size_t student_num = manager.StudentNumber();
+    for (const StudentChunk &chunk : student_chunks)
+        student_num += chunk.students.size();
+    manager.Reserve(student_num, manager.CourseNumber());
+
+    for (const StudentChunk &chunk : student_chunks)
+    {
+        for (const StudentInfo &info : chunk.students)
+            manager.AddStudent(info);  // the first one of an ID wins
+    }
+
+    // read courses, the rosters are installed together at the end
+    std::vector<Manager::SavedRoster> rosters;
+    for (CourseChunk &chunk : course_chunks)
+    {
+        for (CourseRecord &record : chunk.courses)
+        {
+            // a duplicate course still adds students to the first one
+            manager.AddCourse(record.info);
+            rosters.emplace_back(manager.FindCourseHandle(record.info.id),
+                                 std::move(record.roster));
+        }
+    }
+
+    RosterLoadSummary summary;
+    manager.LoadRosters(rosters, true, summary);
     return true;
 }
 
@@ -53,40 +362,258 @@ bool ManagerReader::ReadFinalScore(
         const std::string &file_name,
         Manager &manager,
         CourseInfo::IDType course_id,
-        std::vector<Student::IDType> &unscored_students)
+        std::vector<Student::IDType> &unscored_students,
+        std::vector<Student::IDType> &not_enrolled)
 {
+    error_ = ParseError{0, 0, std::string()};
     if (!manager.HasCourse(course_id))
         return false;
 
-    std::ifstream fin(file_name);
     // if cannot open the file, just continue recording, and return false
+    std::string text;
+    bool opened = ReadWholeFile(file_name, text);
 
-    ScorePiece score_piece;
     FinalScore final_score;
+    if (!ParseFinalScore(text, final_score, error_))
+        return false;
+
+    manager.RecordFinalScore(course_id, final_score, unscored_students,
+                             not_enrolled);
+
+    return opened;
+}
+
+bool ManagerReader::ReadFinalScores(const std::string &path,
+                                    Manager &manager,
+                                    std::vector<FinalScoreFile> &files)
+{
+    error_ = ParseError{0, 0, std::string()};
+    files.clear();
+    if (!ListFinalScoreFiles(path, files, error_))
+        return false;
 
-    while (fin >> score_piece.id >> score_piece.score)
+    for (FinalScoreFile &file : files)
     {
-        final_score.push_back(score_piece);
+        file.recorded = manager.HasCourse(file.course_id);
+        file.error = ParseError{0, 0, std::string()};
+        file.score_num = 0;
     }
 
-    manager.RecordFinalScore(course_id, final_score, unscored_students);
+    // Read, parse and sort on the workers, the manager is left alone
+    std::vector<FinalScore> final_scores(files.size());
+    std::atomic<std::size_t> next_file(0);
+    auto work = [&files, &final_scores, &next_file]()
+    {
+        std::string text;
+        for (std::size_t index = next_file++; index < files.size();
+             index = next_file++)
+        {
+            FinalScoreFile &file = files[index];
+            if (!file.recorded)
+                continue;
 
-    if (!fin.is_open())
+            if (!ReadWholeFile(file.file_name, text) ||
+                !ParseFinalScore(text, final_scores[index], file.error))
+            {
+                file.recorded = false;
+                final_scores[index].clear();
+                continue;
+            }
+            file.score_num = final_scores[index].size();
+            SortFinalScore(final_scores[index]);
+        }
+    };
+
+    RunOnThreads(static_cast<unsigned>(
+                         std::min<std::size_t>(thread_num_, files.size())),
+                 [&work](unsigned) { work(); });
+
+    for (std::size_t index = 0; index < files.size(); index++)
+    {
+        FinalScoreFile &file = files[index];
+        if (file.recorded)
+        {
+            manager.MergeFinalScore(file.course_id, final_scores[index],
+                                    file.unscored_students,
+                                    file.not_enrolled);
+        }
+    }
+    return true;
+}
+
+bool ManagerReader::ReadBatch(const std::string &file_name,
+                              Manager::Batch &batch,
+                              std::size_t &bad_line,
+                              MutationLog *log)
+{
+    std::string text;
+    bad_line = 0;
+    error_ = ParseError{0, 0, std::string()};
+
+    if (!ReadWholeFile(file_name, text))
+        return false;
+
+    TextParser parser(text);
+    while (parser.NextLine())
+    {
+        bad_line = parser.line();
+
+        TextSpan command;
+        if (!parser.NextField(command))  // empty line
+            continue;
+
+        StudentInfo student_info;
+        CourseInfo course_info;
+        std::uint64_t student_id;
+        Course::IDType course_id;
+        ScoreType score;
+        bool parsed;
+
+        std::string name = command.str();
+        if (name == "add-stu")
+        {
+            parsed = parser.ReadStudentInfo(student_info);
+            if (parsed)
+            {
+                batch.AddStudent(student_info);
+                if (log)
+                    log->AddStudent(student_info);
+            }
+        }
+        else if (name == "add-crs")
+        {
+            parsed = parser.ReadCourseInfo(course_info);
+            if (parsed)
+            {
+                batch.AddCourse(course_info);
+                if (log)
+                    log->AddCourse(course_info);
+            }
+        }
+        else if (name == "reg")
+        {
+            parsed = parser.ReadUInt64("student ID", student_id) &&
+                     parser.ReadString("course ID", course_id);
+            if (parsed)
+            {
+                batch.AddStudentToCourse(student_id, course_id);
+                if (log)
+                    log->AddStudentToCourse(student_id, course_id);
+            }
+        }
+        else if (name == "ch-score")
+        {
+            parsed = parser.ReadUInt64("student ID", student_id) &&
+                     parser.ReadString("course ID", course_id) &&
+                     parser.ReadScore("score", score);
+            if (parsed)
+            {
+                batch.ChangeScore(student_id, course_id, score);
+                if (log)
+                    log->ChangeScore(student_id, course_id, score);
+            }
+        }
+        else if (name == "set-stu")
+        {
+            parsed = parser.ReadUInt64("student ID", student_id) &&
+                     parser.ReadStudentInfo(student_info);
+            if (parsed)
+            {
+                batch.SetStudentInfo(student_id, student_info);
+                if (log)
+                    log->SetStudentInfo(student_id, student_info);
+            }
+        }
+        else
+        {
+            parsed = parser.Fail("command", command);
+        }
+
+        if (!parsed || !parser.ExpectLineEnd())
+        {
+            error_ = parser.error();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool ManagerReader::ReadIDMap(const std::string &file_name,
+                              Manager::IDMap &id_map,
+                              std::size_t &bad_line)
+{
+    std::string text;
+    bad_line = 0;
+    error_ = ParseError{0, 0, std::string()};
+
+    if (!ReadWholeFile(file_name, text))
+        return false;
+
+    TextParser parser(text);
+    while (parser.NextLine())
     {
+        bad_line = parser.line();
+        if (parser.AtLineEnd())  // empty line
+            continue;
+
+        std::uint64_t old_id, new_id;
+        if (!parser.ReadUInt64("old student ID", old_id) ||
+            !parser.ReadUInt64("new student ID", new_id) ||
+            !parser.ExpectLineEnd())
+        {
+            error_ = parser.error();
+            return false;
+        }
+
+        id_map.push_back(std::make_pair(old_id, new_id));
+    }
+
+    return true;
+}
+
+bool ManagerReader::ReadStudentIDs(const std::string &file_name,
+                                   std::vector<StudentInfo::IDType> &ids,
+                                   std::size_t &bad_line)
+{
+    std::string text;
+    bad_line = 0;
+    error_ = ParseError{0, 0, std::string()};
+
+    if (!ReadWholeFile(file_name, text))
         return false;
+
+    TextParser parser(text);
+    while (parser.NextLine())
+    {
+        bad_line = parser.line();
+        while (!parser.AtLineEnd())
+        {
+            std::uint64_t id;
+            if (!parser.ReadUInt64("student ID", id))
+            {
+                error_ = parser.error();
+                return false;
+            }
+            ids.push_back(id);
+        }
     }
 
     return true;
 }
 
+ManagerWriter::ManagerWriter() : background_(false)
+{
+}
+
 bool ManagerWriter::Write(const std::string &student_file_name,
                           const std::string &course_file_name,
                           const Manager &manager)
 {
-    std::ofstream student_fout(student_file_name);
-    std::ofstream course_fout(course_file_name);
+    AtomicFile student_file(background_), course_file(background_);
 
-    if (!student_fout.is_open() || !course_fout.is_open())
+    if (!student_file.Open(student_file_name) ||
+        !course_file.Open(course_file_name))
         return false;
 
     // write students
@@ -94,25 +621,34 @@ bool ManagerWriter::Write(const std::string &student_file_name,
          iter != manager.student_end();
          ++iter)
     {
-        student_fout << to_string(iter->info()) << std::endl;
+        AppendStudentInfo(student_file.buffer(), iter->info());
+        student_file.buffer() += '\n';
+        student_file.MaybeFlush();
     }
-    student_fout.close();
 
     // write courses
     for (auto iter = manager.course_begin();
          iter != manager.course_end();
          ++iter)
     {
-        course_fout << to_string(iter->info()) << std::endl;
+        std::string &buffer = course_file.buffer();
+        AppendCourseInfo(buffer, iter->info());
+        buffer += '\n';
 
         for (const ScorePiece &score_piece : iter->final_score())
         {
-            course_fout << score_piece.id << ' ' << score_piece.score << ' ';
+            AppendUInt(buffer, score_piece.id);
+            buffer += ' ';
+            AppendScore(buffer, score_piece.score);
+            buffer += ' ';
         }
-        course_fout << std::endl;
+        buffer += '\n';
+        course_file.MaybeFlush();
     }
 
-    return true;
+    // Each file is replaced atomically, the pair is not: a crash right
+    // between the two renames leaves new students with old courses.
+    return student_file.Commit() && course_file.Commit();
 }
 
 
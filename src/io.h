@@ -2,27 +2,109 @@
 #define SAM_IO_H_
 
 #include "manager.h"
+#include "parallel.h"
+#include "text_parser.h"
 
 namespace SAM {
 
-class ManagerReader
+class MutationLog;
+
+// How one file of ManagerReader::ReadFinalScores() has been recorded
+struct FinalScoreFile
+{
+    CourseInfo::IDType course_id;
+    std::string file_name;
+    // false if the course does not exist, or the file cannot be read or
+    // parsed (error tells where), nothing is recorded then
+    bool recorded;
+    ParseError error;
+    std::size_t score_num;  // in the file
+
+    std::vector<Student::IDType> unscored_students;
+    std::vector<Student::IDType> not_enrolled;  // IDs with a score
+};
+
+// The Read* functions stop at the first malformed field and return false,
+// error() tells where it is.
+class ManagerReader : public ThreadCount
 {
  public:
+    ManagerReader();
+
+    // Large files are split at record boundaries and parsed on up to
+    // thread_num() threads (the number of cores by default). Records are
+    // still added in file order, so the first of two equal IDs wins.
+    // If either file has a malformed record, nothing is added.
     bool Read(const std::string &student_file_name,
               const std::string &course_file_name,
               Manager &manager);
     bool ReadFinalScore(const std::string &file_name,
                         Manager &manager,
                         CourseInfo::IDType course_id,
-                        std::vector<Student::IDType> &unscored_students);
+                        std::vector<Student::IDType> &unscored_students,
+                        std::vector<Student::IDType> &not_enrolled);
+    // Record the final scores of many courses at once. path is a manifest,
+    // one "<course ID> <file name>" per line (relative to the manifest), or
+    // a directory of "<course ID>.txt" files. The files are parsed and
+    // sorted on up to thread_num() threads, then merged into the rosters
+    // in the order listed (see Manager::MergeFinalScore).
+    // Return false if the manifest or directory cannot be read, or the
+    // manifest is malformed; a file that fails only leaves its course out.
+    bool ReadFinalScores(const std::string &path,
+                         Manager &manager,
+                         std::vector<FinalScoreFile> &files);
+
+    // Record edits into batch, one edit per line:
+    //     add-stu <student info>
+    //     add-crs <course info>
+    //     reg <student ID> <course ID>
+    //     ch-score <student ID> <course ID> <score>
+    //     set-stu <student ID> <student info>
+    // Return false if the file cannot be opened or a line cannot be parsed,
+    // bad_line will be set to the number of that line (starting from 1).
+    // If log is given, the edits are also recorded there, to be committed
+    // or aborted together with the batch.
+    bool ReadBatch(const std::string &file_name,
+                   Manager::Batch &batch,
+                   std::size_t &bad_line,
+                   MutationLog *log = nullptr);
+
+    // Read ID changes, one "<old ID> <new ID>" per line.
+    // Return false as ReadBatch() does.
+    bool ReadIDMap(const std::string &file_name,
+                   Manager::IDMap &id_map,
+                   std::size_t &bad_line);
+
+    // Read student IDs, separated by blanks or newlines.
+    // Return false as ReadBatch() does.
+    bool ReadStudentIDs(const std::string &file_name,
+                        std::vector<StudentInfo::IDType> &ids,
+                        std::size_t &bad_line);
+
+    // line is 0 if the last Read* had no parse error
+    const ParseError & error() const { return error_; }
+
+ private:
+    ParseError error_;
 };
 
+// Files are formatted into large buffers and replace the old ones only
+// once they are completely on disk (see AtomicFile).
 class ManagerWriter
 {
  public:
+    ManagerWriter();
+
     bool Write(const std::string &student_file_name,
                const std::string &course_file_name,
                const Manager &manager);
+
+    // Write on a background thread while the next buffer is formatted
+    bool background() const { return background_; }
+    void set_background(bool background) { background_ = background; }
+
+ private:
+    bool background_;
 };
 
 class ManagerIO : public ManagerReader, public ManagerWriter
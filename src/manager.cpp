@@ -1,81 +1,195 @@
+#include <algorithm>
+
 #include "manager.h"
 
 namespace SAM {
 
 Manager::Manager() : students_(),
-                     courses_()
+                     courses_(),
+                     enrollment_(),
+                     semester_index_(),
+                     dirty_departments_(),
+                     ranking_(),
+                     ranking_changes_()
+{
+}
+
+void Manager::Clear()
 {
+    students_.Clear();
+    courses_.Clear();
+    enrollment_.Clear();
+    semester_index_.clear();
+    dirty_departments_.clear();
+    ranking_.Clear();
+    ranking_changes_.clear();
 }
 
 bool Manager::AddStudent(const StudentInfo &student_info)
 {
-    if (students_.count(student_info.id) != 0)  // id has been occupied
+    auto slot = students_.Insert(student_info.id, Student(student_info));
+    if (slot == StudentStore::kNoHandle)  // id has been occupied
         return false;
 
-    students_.emplace(student_info.id, Student(student_info));
+    students_[slot] = Student(student_info, slot, &enrollment_);
+    MarkDirty(student_info.department);
     return true;
 }
 
 bool Manager::RemoveStudent(Student::IDType student_id)
 {
-    auto iter = students_.find(student_id);
-    if (iter == students_.end())  // student not exist
+    auto slot = students_.Find(student_id);
+    if (slot == StudentStore::kNoHandle)  // student not exist
         return false;
 
-    auto  courses_taken = iter->second.courses_taken();
-    for (Course::IDType course_id : courses_taken)
+    MarkStudent(slot);
+    MarkCoursesOf(slot);
+    enrollment_.DropStudent(slot, student_id);
+    students_.Erase(slot);
+    return true;
+}
+
+std::size_t Manager::RemoveStudents(const StudentFilter &filter,
+                                    RemovalSummary &summary)
+{
+    std::vector<StudentHandle> slots;
+    summary.removed_ids.clear();
+    for (auto iter = students_.begin(); iter != students_.end(); ++iter)
     {
-        // Courses are managed by Manager, so this course should exist
-        courses_[course_id].RemoveStudent(iter->second);
+        if (filter(*iter))
+        {
+            slots.push_back(iter.handle());
+            summary.removed_ids.push_back(iter->info().id);
+            MarkStudent(iter.handle());
+            MarkCoursesOf(iter.handle());
+        }
     }
-    students_.erase(iter);
-    return true;
+
+    std::size_t enrollment_num = enrollment_.EnrollmentNumber();
+    summary.course_num = enrollment_.DropStudents(slots);
+    summary.enrollment_num = enrollment_num - enrollment_.EnrollmentNumber();
+
+    for (StudentHandle slot : slots)  // the sorted view is fixed up once
+        students_.Erase(slot);
+
+    return slots.size();
 }
 
 bool Manager::HasStudent(Student::IDType student_id) const
 {
-    return students_.count(student_id) != 0;
+    return students_.Contains(student_id);
 }
 
 Manager::StudentIterator Manager::FindStudent(Student::IDType student_id) const
 {
-    return StudentIterator(students_.find(student_id));
+    return students_.Locate(student_id);
 }
 
 bool Manager::SetStudentInfo(Student::IDType student_id,
                              const StudentInfo &info)
 {
-    auto iter = students_.find(student_id);
-    if (iter == students_.end())
+    auto slot = students_.Find(student_id);
+    if (slot == StudentStore::kNoHandle)
         return false;
 
+    Student &student = students_[slot];
     if (student_id != info.id)  // the id has changed
     {
-        if (students_.count(info.id) != 0)  // id already been taken
+        if (!students_.Rekey(slot, info.id))  // id already been taken
             return false;
 
-        Student new_student(info);
-        // updating IDs
-        auto courses_taken = iter->second.courses_taken();
-        for (Course::IDType course_id : courses_taken)
+        // updating IDs, scores are kept
+        enrollment_.RenumberStudents(
+                std::vector<EnrollmentIndex::StudentEntry>{{info.id, slot}});
+        MarkCoursesOf(slot);
+    }
+
+    MarkStudent(slot);
+    student.set_info(info);
+    MarkStudent(slot);
+    return true;
+}
+
+bool Manager::RenumberStudents(const IDMap &id_map,
+                               std::vector<RenumberConflict> &conflicts)
+{
+    std::size_t conflict_num = conflicts.size();
+
+    IDMap by_old(id_map);
+    std::sort(by_old.begin(), by_old.end());
+    IDMap by_new;  // the changes left, sorted by new ID
+    for (std::size_t index = 0; index < by_old.size(); index++)
+    {
+        const auto &change = by_old[index];
+
+        if (index != 0 && change.first == by_old[index - 1].first)
+        {
+            conflicts.push_back(RenumberConflict{
+                    change.first, change.second,
+                    RenumberConflict::DUPLICATE_OLD_ID});
+        }
+        else if (!students_.Contains(change.first))
+        {
+            conflicts.push_back(RenumberConflict{
+                    change.first, change.second,
+                    RenumberConflict::UNKNOWN_STUDENT});
+        }
+        else if (change.first != change.second)
         {
-            // save scores
-            auto score_before = courses_[course_id].GetScore(student_id);
+            by_new.push_back(change);
+        }
+    }
 
-            courses_[course_id].RemoveStudent(iter->second);
-            courses_[course_id].AddStudent(new_student);
+    std::vector<Student::IDType> leaving;  // old IDs given up, sorted
+    for (const auto &change : by_new)
+        leaving.push_back(change.first);
 
-            // recover scores
-            courses_[course_id].ChangeScore(info.id,
-                                            score_before);
+    std::sort(by_new.begin(), by_new.end(),
+              [](const std::pair<Student::IDType, Student::IDType> &lhs,
+                 const std::pair<Student::IDType, Student::IDType> &rhs)
+              { return lhs.second < rhs.second; });
+
+    for (std::size_t index = 0; index < by_new.size(); index++)
+    {
+        const auto &change = by_new[index];
+        bool owner_moves = std::binary_search(leaving.begin(), leaving.end(),
+                                              change.second);
+
+        if (index != 0 && change.second == by_new[index - 1].second)
+        {
+            conflicts.push_back(RenumberConflict{
+                    change.first, change.second,
+                    RenumberConflict::DUPLICATE_NEW_ID});
         }
+        else if (students_.Contains(change.second) && !owner_moves)
+        {
+            conflicts.push_back(RenumberConflict{
+                    change.first, change.second,
+                    RenumberConflict::NEW_ID_TAKEN});
+        }
+    }
+
+    if (conflicts.size() != conflict_num)
+        return false;
 
-        students_.erase(iter);
-        students_.emplace(info.id, new_student);
+    std::vector<std::pair<StudentHandle, Student::IDType>> rekeys;
+    std::vector<EnrollmentIndex::StudentEntry> entries;
+    for (const auto &change : by_new)
+    {
+        auto slot = students_.Find(change.first);
+        rekeys.push_back(std::make_pair(slot, change.second));
+        entries.push_back(EnrollmentIndex::StudentEntry{change.second, slot});
+        MarkStudent(slot);
+        MarkCoursesOf(slot);
     }
-    else  // id stay the same
+
+    students_.RekeyMany(rekeys);
+    enrollment_.RenumberStudents(entries);
+    for (const auto &entry : entries)
     {
-        iter->second.set_info(info);
+        StudentInfo info = students_[entry.handle].info();
+        info.id = entry.id;
+        students_[entry.handle].set_info(info);
     }
 
     return true;
@@ -83,159 +197,750 @@ bool Manager::SetStudentInfo(Student::IDType student_id,
 
 bool Manager::AddCourse(const CourseInfo &info)
 {
-    if (courses_.count(info.id) != 0)  // id has been occupied
+    auto slot = courses_.Insert(info.id, Course(info));
+    if (slot == CourseStore::kNoHandle)  // id has been occupied
         return false;
 
-    courses_.emplace(info.id, Course(info));
+    courses_[slot] = Course(info, slot, &enrollment_);
+    enrollment_.SetCredit(slot, info.credit);
+    if (courses_[slot].key() != kNoCourseKey)
+        semester_index_.insert(std::make_pair(courses_[slot].key(), slot));
+    MarkDirty(info.department);
     return true;
 }
 
+void Manager::LoadRosters(std::vector<SavedRoster> &rosters,
+                          bool check_capacity,
+                          RosterLoadSummary &summary)
+{
+    summary = RosterLoadSummary{0, 0, 0};
+
+    // records of the same course stay in file order
+    std::stable_sort(rosters.begin(), rosters.end(),
+                     [](const SavedRoster &lhs, const SavedRoster &rhs)
+                     { return lhs.first < rhs.first; });
+
+    std::vector<std::vector<EnrollmentIndex::RosterEntry>> additions(
+            courses_.HandleLimit());
+    FinalScore pieces, old_scores;
+    std::vector<std::size_t> order, candidates;
+    std::vector<EnrollmentIndex::RosterEntry> new_entries;
+    std::vector<bool> admitted;
+    std::vector<Student::IDType> not_enrolled;
+
+    for (std::size_t begin = 0, end = 0; begin < rosters.size(); begin = end)
+    {
+        CourseHandle course = rosters[begin].first;
+        MarkCourse(course);
+        pieces.clear();
+        for (end = begin; end < rosters.size() && rosters[end].first == course;
+             end++)
+        {
+            pieces.insert(pieces.end(), rosters[end].second.begin(),
+                          rosters[end].second.end());
+        }
+
+        // sort once, by ID and then by position in the file
+        order.resize(pieces.size());
+        for (std::size_t index = 0; index < order.size(); index++)
+            order[index] = index;
+        std::sort(order.begin(), order.end(),
+                  [&pieces](std::size_t lhs, std::size_t rhs)
+                  {
+                      return pieces[lhs].id < pieces[rhs].id ||
+                             (pieces[lhs].id == pieces[rhs].id && lhs < rhs);
+                  });
+
+        // walk the IDs along the roster: students already in the course
+        // only get their last score, new ones become candidates
+        RosterView roster = enrollment_.Roster(course);
+        const Student::IDType *roster_pos = roster.ids();
+        const Student::IDType *roster_end = roster.ids() + roster.size();
+        old_scores.clear();
+        candidates.clear();
+        new_entries.clear();
+
+        for (std::size_t i = 0, j; i < order.size(); i = j)
+        {
+            Student::IDType id = pieces[order[i]].id;
+            for (j = i + 1; j < order.size() && pieces[order[j]].id == id; j++)
+                ;
+            const ScorePiece &last = pieces[order[j - 1]];
+
+            roster_pos = std::lower_bound(roster_pos, roster_end, id);
+            if (roster_pos != roster_end && *roster_pos == id)
+            {
+                old_scores.push_back(last);
+                continue;
+            }
+
+            auto slot = students_.Find(id);
+            if (slot == StudentStore::kNoHandle)
+            {
+                summary.unknown_students++;
+                continue;
+            }
+
+            candidates.push_back(order[i]);  // its first position
+            new_entries.push_back(
+                    EnrollmentIndex::RosterEntry{id, slot, last.score});
+        }
+
+        // give the seats left in file order
+        admitted.assign(candidates.size(), true);
+        if (check_capacity)
+        {
+            std::size_t capacity = courses_[course].info().capacity;
+            std::size_t seats = roster.size() < capacity ?
+                                capacity - roster.size() : 0;
+            if (candidates.size() > seats)
+            {
+                std::vector<std::size_t> by_position(candidates.size());
+                for (std::size_t index = 0; index < by_position.size(); index++)
+                    by_position[index] = index;
+                std::sort(by_position.begin(), by_position.end(),
+                          [&candidates](std::size_t lhs, std::size_t rhs)
+                          { return candidates[lhs] < candidates[rhs]; });
+
+                for (std::size_t rank = seats; rank < by_position.size();
+                     rank++)
+                    admitted[by_position[rank]] = false;
+                summary.over_capacity += candidates.size() - seats;
+            }
+        }
+
+        auto &entries = additions[course];
+        for (std::size_t index = 0; index < new_entries.size(); index++)
+        {
+            if (admitted[index])
+                entries.push_back(new_entries[index]);
+        }
+
+        enrollment_.MergeScores(course, old_scores, not_enrolled);
+        summary.enrolled += entries.size();
+    }
+
+    enrollment_.AddRosters(additions);
+}
+
 bool Manager::RemoveCourse(Course::IDType course_id)
 {
-    auto iter = courses_.find(course_id);
-    if (iter == courses_.end())  // course not found
+    auto slot = courses_.Find(course_id);
+    if (slot == CourseStore::kNoHandle)  // course not found
         return false;
 
-    auto final_score = iter->second.final_score();
-    for (ScorePiece score_piece : final_score)
-    {
-        students_[score_piece.id].RemoveCourse(course_id);
-    }
-    courses_.erase(iter);
+    MarkCourse(slot);
+    semester_index_.erase(std::make_pair(courses_[slot].key(), slot));
+    enrollment_.DropCourse(slot);
+    courses_.Erase(slot);
     return true;
 }
 
 bool Manager::HasCourse(Course::IDType course_id) const
 {
-    return courses_.count(course_id) != 0;
+    return courses_.Contains(course_id);
 }
 
 Manager::CourseIterator Manager::FindCourse(Course::IDType course_id) const
 {
-    return CourseIterator(courses_.find(course_id));
+    return courses_.Locate(course_id);
 }
 
 bool Manager::SetCourseInfo(Course::IDType course_id,
                             const CourseInfo &info)
 {
-    auto iter = courses_.find(course_id);
-    if (iter == courses_.end())
+    auto slot = courses_.Find(course_id);
+    if (slot == CourseStore::kNoHandle)
         return false;
 
-    if (course_id != info.id)  // the id has changed
-    {
-        if (courses_.count(info.id) != 0)
-            return false;  // new id has been taken
+    // students refer to the handle, which is kept by Rekey
+    if (course_id != info.id && !courses_.Rekey(slot, info.id))
+        return false;  // new id has been taken
+
+    MarkCourse(slot);
+    Course &course = courses_[slot];
+    semester_index_.erase(std::make_pair(course.key(), slot));
+    course.set_info(info);
+    enrollment_.SetCredit(slot, info.credit);  // for its students' GPA
+    if (course.key() != kNoCourseKey)
+        semester_index_.insert(std::make_pair(course.key(), slot));
+    MarkCourse(slot);
+    return true;
+}
 
-        Course new_course(iter->second);
-        new_course.set_info(info);
-        // updating IDs
-        for (ScorePiece score_piece : new_course.final_score())
+bool Manager::CheckCredits(std::vector<Student::IDType> *wrong) const
+{
+    std::vector<StudentHandle> handles;
+    bool consistent = enrollment_.CheckCredits(&handles);
+    if (wrong)
+    {
+        for (StudentHandle handle : handles)
         {
-            students_[score_piece.id].RemoveCourse(course_id);
-            students_[score_piece.id].AddCourse(info.id);
+            if (students_.IsLive(handle))
+                wrong->push_back(students_[handle].info().id);
         }
-
-        courses_.erase(iter);
-        courses_.emplace(info.id, new_course);
     }
-    else  // the id stay the same
+    return consistent;
+}
+
+const GpaRanking & Manager::Ranking()
+{
+    std::vector<StudentHandle> changed(ranking_changes_.begin(),
+                                       ranking_changes_.end());
+    ranking_changes_.clear();
+    enrollment_.TakeCreditChanges(changed);
+
+    for (StudentHandle student : changed)
     {
-        iter->second.set_info(info);
+        if (students_.IsLive(student))
+        {
+            const Student &changed_student = students_[student];
+            ranking_.Update(student, changed_student.info().id,
+                            changed_student.info().department,
+                            changed_student.gpa());
+        }
+        else
+        {
+            ranking_.Remove(student);
+        }
     }
+    return ranking_;
+}
 
-    return true;
+void Manager::SortByCourseID(std::vector<CourseHandle> &handles) const
+{
+    std::sort(handles.begin(), handles.end(),
+              [this](CourseHandle lhs, CourseHandle rhs)
+              { return courses_.key(lhs) < courses_.key(rhs); });
+}
+
+void Manager::FindCourses(CourseKey begin, CourseKey end,
+                          std::vector<CourseHandle> &handles) const
+{
+    for (auto iter = semester_index_.lower_bound(std::make_pair(begin, 0u));
+         iter != semester_index_.end() && iter->first < end;
+         ++iter)
+        handles.push_back(iter->second);
+}
+
+ScoreSketch Manager::MergeSketches(int department) const
+{
+    ScoreSketch sketch(enrollment_.sketch_resolution());
+    for (auto iter = courses_.begin(); iter != courses_.end(); ++iter)
+    {
+        if (department == GpaRanking::kAllDepartments ||
+            iter->info().department == department)
+            sketch.Merge(iter->sketch());
+    }
+    return sketch;
 }
 
 bool Manager::AddStudentToCourse(Student::IDType student_id,
                                  Course::IDType course_id)
 {
-    auto iter_student = students_.find(student_id);
-    auto iter_course = courses_.find(course_id);
+    auto student_slot = students_.Find(student_id);
+    auto course_slot = courses_.Find(course_id);
+
+    if (student_slot == StudentStore::kNoHandle ||
+        course_slot == CourseStore::kNoHandle)
+        return false;
 
-    if (iter_student == students_.end() ||
-        iter_course == courses_.end())
+    if (!courses_[course_slot].AddStudent(students_[student_slot]))
         return false;
 
-    return iter_course->second.AddStudent(iter_student->second);
+    MarkCourse(course_slot);
+    return true;
 }
 
 bool Manager::AddStudentToCourse(
         const std::vector<Student::IDType> &student_ids,
         Course::IDType course_id)
 {
-    auto iter_course = courses_.find(course_id);
+    std::vector<EnrollOutcome> outcomes;
+    if (!AddStudentToCourse(student_ids, course_id, outcomes))
+        return false;
+
+    for (const EnrollOutcome &outcome : outcomes)
+    {
+        if (outcome.status == EnrollOutcome::ADDED ||
+            outcome.status == EnrollOutcome::ALREADY_ENROLLED)
+            return true;
+    }
+    return false;
+}
 
-    if (iter_course == courses_.end())
+bool Manager::AddStudentToCourse(
+        const std::vector<Student::IDType> &student_ids,
+        Course::IDType course_id,
+        std::vector<EnrollOutcome> &outcomes)
+{
+    auto course_slot = courses_.Find(course_id);
+    if (course_slot == CourseStore::kNoHandle)
         return false;
 
-    bool added_at_least_one = false;
-    for (auto student_id : student_ids)
+    outcomes.resize(student_ids.size());
+    for (std::size_t index = 0; index < student_ids.size(); index++)
+        outcomes[index].id = student_ids[index];
+
+    // positions in student_ids, sorted by ID (then by position)
+    std::vector<std::size_t> order(student_ids.size());
+    for (std::size_t index = 0; index < order.size(); index++)
+        order[index] = index;
+    std::sort(order.begin(), order.end(),
+              [&student_ids](std::size_t lhs, std::size_t rhs)
+              {
+                  return student_ids[lhs] < student_ids[rhs] ||
+                         (student_ids[lhs] == student_ids[rhs] && lhs < rhs);
+              });
+
+    // walk the sorted IDs along the roster
+    RosterView roster = courses_[course_slot].final_score();
+    const Student::IDType *roster_pos = roster.ids();
+    const Student::IDType *roster_end = roster.ids() + roster.size();
+    std::vector<std::size_t> candidates;  // first position of new students
+
+    for (std::size_t i = 0; i < order.size(); i++)
+    {
+        std::size_t index = order[i];
+        Student::IDType id = student_ids[index];
+
+        if (i != 0 && id == student_ids[order[i - 1]])
+            continue;  // a duplicate, decided below
+
+        roster_pos = std::lower_bound(roster_pos, roster_end, id);
+        if (roster_pos != roster_end && *roster_pos == id)
+            outcomes[index].status = EnrollOutcome::ALREADY_ENROLLED;
+        else if (!students_.Contains(id))
+            outcomes[index].status = EnrollOutcome::UNKNOWN_STUDENT;
+        else
+            candidates.push_back(index);
+    }
+
+    // give the seats left in request order
+    std::sort(candidates.begin(), candidates.end());
+    std::size_t capacity = courses_[course_slot].info().capacity;
+    std::size_t seats = roster.size() < capacity ? capacity - roster.size() : 0;
+
+    std::vector<EnrollmentIndex::StudentEntry> added;
+    for (std::size_t i = 0; i < candidates.size(); i++)
     {
-        auto iter_student = students_.find(student_id);
-        if (iter_student != students_.end())
+        EnrollOutcome &outcome = outcomes[candidates[i]];
+        if (i < seats)
         {
-            if (iter_course->second.AddStudent(iter_student->second))
-                added_at_least_one = true;
+            outcome.status = EnrollOutcome::ADDED;
+            added.push_back(EnrollmentIndex::StudentEntry{
+                    outcome.id, students_.Find(outcome.id)});
         }
+        else
+        {
+            outcome.status = EnrollOutcome::OVER_CAPACITY;
+        }
+    }
+
+    // later occurrences of an ID share the outcome of the first one
+    for (std::size_t i = 1; i < order.size(); i++)
+    {
+        if (student_ids[order[i]] != student_ids[order[i - 1]])
+            continue;
+
+        auto status = outcomes[order[i - 1]].status;
+        outcomes[order[i]].status = (status == EnrollOutcome::ADDED ?
+                                     EnrollOutcome::ALREADY_ENROLLED : status);
     }
 
-    return added_at_least_one;
+    std::sort(added.begin(), added.end(),
+              [](const EnrollmentIndex::StudentEntry &lhs,
+                 const EnrollmentIndex::StudentEntry &rhs)
+              { return lhs.id < rhs.id; });
+    enrollment_.EnrollMany(course_slot, added);
+    if (!added.empty())
+        MarkCourse(course_slot);
+    return true;
 }
 
 bool Manager::RemoveStudentFromCourse(Student::IDType student_id,
                                       Course::IDType course_id)
 {
-    auto iter_student = students_.find(student_id);
-    auto iter_course = courses_.find(course_id);
+    auto student_slot = students_.Find(student_id);
+    auto course_slot = courses_.Find(course_id);
 
-    if (iter_student == students_.end() ||
-        iter_course == courses_.end())
+    if (student_slot == StudentStore::kNoHandle ||
+        course_slot == CourseStore::kNoHandle)
         return false;
 
-    iter_course->second.RemoveStudent(iter_student->second);
+    courses_[course_slot].RemoveStudent(students_[student_slot]);
+    MarkCourse(course_slot);
     return true;
 }
 
 bool Manager::RecordFinalScore(const Course::IDType &course_id,
                                const FinalScore &final_score,
-                               std::vector<Student::IDType> &unscored_students)
+                               std::vector<Student::IDType> &unscored_students,
+                               std::vector<Student::IDType> &not_enrolled)
+{
+    auto slot = courses_.Find(course_id);
+    if (slot == CourseStore::kNoHandle)
+        return false;
+
+    courses_[slot].RecordFinalScore(final_score, unscored_students,
+                                    not_enrolled);
+    MarkCourse(slot);
+    return true;
+}
+
+bool Manager::MergeFinalScore(const Course::IDType &course_id,
+                              const FinalScore &final_score,
+                              std::vector<Student::IDType> &unscored_students,
+                              std::vector<Student::IDType> &not_enrolled)
 {
-    auto iter = courses_.find(course_id);
-    if (iter == courses_.end())
+    auto slot = courses_.Find(course_id);
+    if (slot == CourseStore::kNoHandle)
         return false;
 
-    iter->second.RecordFinalScore(final_score, unscored_students);
+    courses_[slot].MergeFinalScore(final_score, unscored_students,
+                                   not_enrolled);
+    MarkCourse(slot);
     return true;
 }
 
 void Manager::RemoveFinalScore(const Course::IDType &course_id)
 {
-    auto iter = courses_.find(course_id);
+    auto slot = courses_.Find(course_id);
 
-    if (iter != courses_.end())
-        iter->second.RemoveFinalScore();
+    if (slot != CourseStore::kNoHandle)
+    {
+        courses_[slot].RemoveFinalScore();
+        MarkCourse(slot);
+    }
 }
 
 ScoreType Manager::GetScore(Student::IDType student_id,
                             const Course::IDType &course_id) const
 {
-    auto iter = courses_.find(course_id);
-    if (iter == courses_.end())
-        return false;
+    auto slot = courses_.Find(course_id);
+    if (slot == CourseStore::kNoHandle)
+        return kInvalidScore;
 
-    return iter->second.GetScore(student_id);
+    return courses_[slot].GetScore(student_id);
 }
 
 bool Manager::ChangeScore(Student::IDType student_id,
                           const Course::IDType &course_id,
                           ScoreType new_score)
 {
-    auto iter = courses_.find(course_id);
-    if (iter == courses_.end())
+    auto slot = courses_.Find(course_id);
+    if (slot == CourseStore::kNoHandle)
         return false;
 
-    return iter->second.ChangeScore(student_id, new_score);
+    if (!courses_[slot].ChangeScore(student_id, new_score))
+        return false;
+
+    MarkCourse(slot);
+    return true;
+}
+
+void Manager::MarkCoursesOf(StudentHandle student)
+{
+    for (CourseHandle course : enrollment_.CoursesOf(student))
+        MarkCourse(course);
+}
+
+// ================================ Batch ================================
+const Manager::Batch::Ref Manager::Batch::kNewItem;
+const Manager::Batch::Ref Manager::Batch::kNoItem;
+
+Manager::Batch::Batch(Manager &manager)
+        : manager_(manager),
+          new_students_(),
+          new_courses_(),
+          student_ids_(),
+          course_ids_(),
+          changed_students_(),
+          renames_(),
+          enrollments_(),
+          roster_growth_(),
+          scores_(),
+          edit_num_(0),
+          first_failure_(0)
+{
+}
+
+bool Manager::Batch::AddStudent(const StudentInfo &info)
+{
+    if (FindStudent(info.id) != kNoItem)  // id has been occupied
+        return Record(false);
+
+    student_ids_[info.id] = kNewItem + new_students_.size();
+    new_students_.push_back(info);
+    return Record(true);
+}
+
+bool Manager::Batch::AddCourse(const CourseInfo &info)
+{
+    if (FindCourse(info.id) != kNoItem)  // id has been occupied
+        return Record(false);
+
+    course_ids_[info.id] = kNewItem + new_courses_.size();
+    new_courses_.push_back(info);
+    return Record(true);
+}
+
+bool Manager::Batch::AddStudentToCourse(Student::IDType student_id,
+                                        const Course::IDType &course_id)
+{
+    Ref student = FindStudent(student_id);
+    Ref course = FindCourse(course_id);
+    if (student == kNoItem || course == kNoItem)
+        return Record(false);
+
+    // same rule as Course::AddStudent
+    std::size_t roster_size = roster_growth_[course];
+    std::size_t capacity;
+    if (course < kNewItem)
+    {
+        roster_size += manager_.enrollment_.RosterSize(course);
+        capacity = manager_.courses_[course].info().capacity;
+    }
+    else
+    {
+        capacity = new_courses_[course - kNewItem].capacity;
+    }
+
+    if (roster_size == capacity)  // full
+        return Record(false);
+
+    if (!IsEnrolled(student, course))
+    {
+        enrollments_.insert(std::make_pair(student, course));
+        roster_growth_[course]++;
+    }
+    return Record(true);
+}
+
+bool Manager::Batch::ChangeScore(Student::IDType student_id,
+                                 const Course::IDType &course_id,
+                                 ScoreType new_score)
+{
+    Ref student = FindStudent(student_id);
+    Ref course = FindCourse(course_id);
+    if (student == kNoItem || course == kNoItem ||
+        !IsEnrolled(student, course))
+        return Record(false);
+
+    scores_.push_back(ScoreEdit{student, course, new_score});
+    return Record(true);
+}
+
+bool Manager::Batch::SetStudentInfo(Student::IDType student_id,
+                                    const StudentInfo &info)
+{
+    Ref student = FindStudent(student_id);
+    if (student == kNoItem)
+        return Record(false);
+
+    if (student_id != info.id)  // the id has changed
+    {
+        if (FindStudent(info.id) != kNoItem)  // id already been taken
+            return Record(false);
+
+        student_ids_[student_id] = kNoItem;
+        student_ids_[info.id] = student;
+        if (student < kNewItem)
+            renames_.push_back(std::make_pair(student, info.id));
+    }
+
+    if (student < kNewItem)
+        changed_students_[student] = info;
+    else
+        new_students_[student - kNewItem] = info;
+    return Record(true);
+}
+
+bool Manager::Batch::Commit()
+{
+    if (first_failure_ != edit_num_)
+    {
+        Clear();
+        return false;
+    }
+
+    Manager &manager = manager_;
+
+    // existing students: IDs are changed in the recorded order so that each
+    // new ID is free when taken
+    for (const auto &rename : renames_)
+        manager.students_.Rekey(rename.first, rename.second);
+
+    std::vector<EnrollmentIndex::StudentEntry> renumbered;
+    for (const auto &change : changed_students_)
+    {
+        Student &student = manager.students_[change.first];
+        if (student.info().id != change.second.id)
+        {
+            renumbered.push_back(EnrollmentIndex::StudentEntry{
+                    change.second.id, change.first});
+            manager.MarkCoursesOf(change.first);
+        }
+        manager.MarkStudent(change.first);
+        student.set_info(change.second);
+        manager.MarkStudent(change.first);
+    }
+    manager.enrollment_.RenumberStudents(renumbered);
+
+    // new students and courses
+    std::vector<StudentHandle> student_handles;
+    for (const StudentInfo &info : new_students_)
+    {
+        manager.AddStudent(info);
+        student_handles.push_back(manager.students_.Find(info.id));
+    }
+
+    std::vector<CourseHandle> course_handles;
+    for (const CourseInfo &info : new_courses_)
+    {
+        manager.AddCourse(info);
+        course_handles.push_back(manager.courses_.Find(info.id));
+    }
+
+    auto student_handle = [&student_handles](Ref ref)
+    {
+        return ref < kNewItem ? static_cast<StudentHandle>(ref)
+                              : student_handles[ref - kNewItem];
+    };
+    auto course_handle = [&course_handles](Ref ref)
+    {
+        return ref < kNewItem ? static_cast<CourseHandle>(ref)
+                              : course_handles[ref - kNewItem];
+    };
+
+    // enrollments, merged into every roster once
+    typedef std::pair<CourseHandle, EnrollmentIndex::StudentEntry> Enrollment;
+    std::vector<Enrollment> enrollments;
+    enrollments.reserve(enrollments_.size());
+    for (const auto &pair : enrollments_)
+    {
+        StudentHandle student = student_handle(pair.first);
+        enrollments.push_back(Enrollment(
+                course_handle(pair.second),
+                EnrollmentIndex::StudentEntry{
+                        manager.students_[student].info().id, student}));
+    }
+    std::sort(enrollments.begin(), enrollments.end(),
+              [](const Enrollment &lhs, const Enrollment &rhs)
+              {
+                  return lhs.first < rhs.first ||
+                         (lhs.first == rhs.first &&
+                          lhs.second.id < rhs.second.id);
+              });
+
+    std::vector<EnrollmentIndex::StudentEntry> roster_part;
+    for (std::size_t begin = 0, end; begin < enrollments.size(); begin = end)
+    {
+        roster_part.clear();
+        for (end = begin; end < enrollments.size() &&
+                          enrollments[end].first == enrollments[begin].first;
+             end++)
+            roster_part.push_back(enrollments[end].second);
+
+        manager.enrollment_.EnrollMany(enrollments[begin].first, roster_part);
+        manager.MarkCourse(enrollments[begin].first);
+    }
+
+    // scores, the last one of a student wins
+    typedef std::pair<CourseHandle, ScorePiece> Score;
+    std::vector<Score> scores;
+    scores.reserve(scores_.size());
+    for (const ScoreEdit &edit : scores_)
+    {
+        StudentHandle student = student_handle(edit.student);
+        scores.push_back(Score(
+                course_handle(edit.course),
+                ScorePiece{manager.students_[student].info().id, edit.score}));
+    }
+    std::stable_sort(scores.begin(), scores.end(),
+                     [](const Score &lhs, const Score &rhs)
+                     {
+                         return lhs.first < rhs.first ||
+                                (lhs.first == rhs.first &&
+                                 lhs.second.id < rhs.second.id);
+                     });
+
+    FinalScore course_scores;
+    std::vector<Student::IDType> not_enrolled;  // stays empty
+    for (std::size_t begin = 0, end; begin < scores.size(); begin = end)
+    {
+        course_scores.clear();
+        for (end = begin; end < scores.size() &&
+                          scores[end].first == scores[begin].first; end++)
+        {
+            if (!course_scores.empty() &&
+                course_scores.back().id == scores[end].second.id)
+                course_scores.back() = scores[end].second;
+            else
+                course_scores.push_back(scores[end].second);
+        }
+
+        manager.enrollment_.MergeScores(scores[begin].first, course_scores,
+                                        not_enrolled);
+        manager.MarkCourse(scores[begin].first);
+    }
+
+    Clear();
+    return true;
+}
+
+void Manager::Batch::Clear()
+{
+    new_students_.clear();
+    new_courses_.clear();
+    student_ids_.clear();
+    course_ids_.clear();
+    changed_students_.clear();
+    renames_.clear();
+    enrollments_.clear();
+    roster_growth_.clear();
+    scores_.clear();
+    edit_num_ = first_failure_ = 0;
+}
+
+Manager::Batch::Ref Manager::Batch::FindStudent(
+        Student::IDType student_id) const
+{
+    auto iter = student_ids_.find(student_id);
+    if (iter != student_ids_.end())
+        return iter->second;
+
+    auto slot = manager_.students_.Find(student_id);
+    return slot == StudentStore::kNoHandle ? kNoItem : slot;
+}
+
+Manager::Batch::Ref Manager::Batch::FindCourse(
+        const Course::IDType &course_id) const
+{
+    auto iter = course_ids_.find(course_id);
+    if (iter != course_ids_.end())
+        return iter->second;
+
+    auto slot = manager_.courses_.Find(course_id);
+    return slot == CourseStore::kNoHandle ? kNoItem : slot;
+}
+
+bool Manager::Batch::IsEnrolled(Ref student, Ref course) const
+{
+    if (student < kNewItem && course < kNewItem &&
+        manager_.enrollment_.CoursesOf(student).Contains(course))
+        return true;
+
+    return enrollments_.count(std::make_pair(student, course)) != 0;
+}
+
+bool Manager::Batch::Record(bool valid)
+{
+    if (valid && first_failure_ == edit_num_)
+        first_failure_++;
+
+    edit_num_++;
+    return valid;
 }
 
 }  // namespace SAM
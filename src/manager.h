@@ -1,82 +1,116 @@
 #ifndef SAM_MANAGER_H_
 #define SAM_MANAGER_H_
 
-#include <iterator>
-#include <map>
+#include <cstdint>
+
+#include <functional>
+#include <set>
 #include <string>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
-#include "student.h"
 #include "course.h"
+#include "dense_store.h"
+#include "enrollment.h"
+#include "gpa_ranking.h"
+#include "student.h"
 
 namespace SAM {
 
-// Manage students and courses.
-// Every student/course should has an unique id.
-class Manager
+// What happened to one student of a bulk registration
+struct EnrollOutcome
 {
- public:
-    template <typename KeyType, typename ItemType>
-    class MapItemIterator
-            : public std::iterator<std::bidirectional_iterator_tag, ItemType>
-    {
-     private:
-        typedef typename std::map<KeyType, ItemType>::const_iterator MapIter;
-
-     public:
-        explicit MapItemIterator(MapIter map_iter) : map_iter_(map_iter) {}
+    enum Status { ADDED, ALREADY_ENROLLED, UNKNOWN_STUDENT, OVER_CAPACITY };
 
-        bool operator==(const MapItemIterator &rhs) const
-        { return map_iter_ == rhs.map_iter_; }
+    StudentInfo::IDType id;
+    Status status;
+};
 
-        bool operator!=(const MapItemIterator &rhs) const
-        { return map_iter_ != rhs.map_iter_; }
+// Why an ID change of Manager::RenumberStudents cannot be done
+struct RenumberConflict
+{
+    enum Reason {
+        UNKNOWN_STUDENT,   // no student has the old ID
+        DUPLICATE_OLD_ID,  // the old ID is given more than once
+        DUPLICATE_NEW_ID,  // the new ID is given to more than one student
+        NEW_ID_TAKEN       // a student keeping his ID has the new ID
+    };
 
-        const ItemType & operator*() const { return map_iter_->second; }
-        const ItemType * operator->() const { return &(map_iter_->second); }
+    StudentInfo::IDType old_id;
+    StudentInfo::IDType new_id;
+    Reason reason;
+};
 
-        MapItemIterator & operator++()
-        {
-            ++map_iter_;
-            return *this;
-        }
+// What Manager::RemoveStudents has done
+struct RemovalSummary
+{
+    std::vector<StudentInfo::IDType> removed_ids;  // sorted
+    std::size_t enrollment_num;  // registrations dropped
+    std::size_t course_num;      // courses that lost students
+};
 
-        MapItemIterator operator++(int)
-        {
-            return MapItemIterator(map_iter_++);
-        }
+// What Manager::LoadRosters has done
+struct RosterLoadSummary
+{
+    std::size_t enrolled;          // registrations added
+    std::size_t unknown_students;  // (course, ID) pairs naming no student
+    std::size_t over_capacity;     // students left out of a full course
+};
 
-        MapItemIterator & operator--()
-        {
-            --map_iter_;
-            return *this;
-        }
+// Manage students and courses.
+// Every student/course should has an unique id.
+class Manager
+{
+ public:
+    typedef DenseStore<Student::IDType, Student> StudentStore;
+    typedef DenseStore<Course::IDType, Course> CourseStore;
 
-        MapItemIterator operator--(int)
-        {
-            return MapItemIterator(map_iter_--);
-        }
+    // Iterate in ID order. Invalidated by any mutation of the manager.
+    typedef StudentStore::ConstIterator StudentIterator;
+    typedef CourseStore::ConstIterator CourseIterator;
 
-     private:
-        MapIter map_iter_;
-    };
+    typedef std::function<bool(const Student &)> StudentFilter;
 
-    typedef MapItemIterator<Student::IDType, Student> StudentIterator;
-    typedef MapItemIterator<Course::IDType, Course> CourseIterator;
+    class Batch;
 
     Manager();
+    // Students and courses point to the enrollment index of their manager
+    Manager(const Manager &) = delete;
+    Manager & operator=(const Manager &) = delete;
+
+    // Remove every student and course, as if just constructed (the sketch
+    // resolution is kept)
+    void Clear();
 
     // ======================= Operations for students =======================
     bool AddStudent(const StudentInfo &student_info);
     bool RemoveStudent(Student::IDType student_id);
+    // Remove every student the filter accepts, such as a graduating class.
+    // Each roster involved is compacted once, whatever the number of
+    // students. Return the number of students removed.
+    std::size_t RemoveStudents(const StudentFilter &filter,
+                               RemovalSummary &summary);
     bool HasStudent(Student::IDType student_id) const;
     StudentIterator FindStudent(Student::IDType student_id) const;
+    // handle shall be valid, such as one of a roster
+    const Student & student(StudentHandle handle) const
+    { return students_[handle]; }
 
     // IDs that courses have will be updated if needed.
     // If the new ID has been taken, nothing will be changed.
     bool SetStudentInfo(Student::IDType student_id,
                         const StudentInfo &info);
 
+    // Change the IDs of many students at once (old ID -> new ID), all the
+    // changes happen together, so students may swap IDs.
+    // Every roster is rewritten at most once.
+    // If any change is impossible, nothing will be changed, and every
+    // problem found will be added to the back of conflicts.
+    typedef std::vector<std::pair<Student::IDType, Student::IDType>> IDMap;
+    bool RenumberStudents(const IDMap &id_map,
+                          std::vector<RenumberConflict> &conflicts);
+
 
     // ======================= Operations for courses =======================
     bool AddCourse(const CourseInfo &info);
@@ -84,17 +118,54 @@ class Manager
     bool HasCourse(Course::IDType course_id) const;
     CourseIterator FindCourse(Course::IDType course_id) const;
 
-    // IDs that courses have will be updated if needed.
+    // Students refer to the course by handle, so they need no update.
     // If the new ID has been taken, nothing will be changed.
     bool SetCourseInfo(Course::IDType course_id,
                        const CourseInfo &info);
 
+    // The course ID table: every course gets a handle when added, which stays
+    // the same until the course is removed (even if its ID changes).
+    // Return kNoCourse if not found.
+    CourseHandle FindCourseHandle(const Course::IDType &course_id) const
+    { return courses_.Find(course_id); }
+    // handle shall be valid
+    const Course & course(CourseHandle handle) const
+    { return courses_[handle]; }
+    // Sort handles in course ID order, for display
+    void SortByCourseID(std::vector<CourseHandle> &handles) const;
+
+    // The semester index: handles of the courses whose key (see
+    // Course::key()) is in [begin, end), such as the range ParseSemester()
+    // gives, will be added to the back of handles in key order.
+    // Courses with IDs in another format are not indexed.
+    void FindCourses(CourseKey begin, CourseKey end,
+                     std::vector<CourseHandle> &handles) const;
+
+    // The score sketches of the courses the department offers merged into
+    // one, of every course for GpaRanking::kAllDepartments
+    ScoreSketch MergeSketches(int department) const;
+    // The error bound of every score sketch, see ScoreSketch
+    double sketch_resolution() const
+    { return enrollment_.sketch_resolution(); }
+    // Every sketch is built again from the rosters
+    void SetSketchResolution(double resolution)
+    { enrollment_.SetSketchResolution(resolution); }
+
 
     // ================== Operations for students & courses ==================
     bool AddStudentToCourse(Student::IDType student_id,
                             Course::IDType course_id);
+    // Return true if at least one of them is in the course afterwards.
     bool AddStudentToCourse(const std::vector<Student::IDType> &student_ids,
                             Course::IDType course_id);
+    // Register many students at once: the IDs are sorted and merged into the
+    // roster in one pass. The seats left are given in the order of
+    // student_ids, the others get OVER_CAPACITY.
+    // outcomes[i] will be the outcome of student_ids[i].
+    // Return false if the course does not exist.
+    bool AddStudentToCourse(const std::vector<Student::IDType> &student_ids,
+                            Course::IDType course_id,
+                            std::vector<EnrollOutcome> &outcomes);
     bool RemoveStudentFromCourse(Student::IDType student_id,
                                  Course::IDType course_id);
 
@@ -102,10 +173,18 @@ class Manager
     // Record final scores.
     // If a student is unscored after update, his ID will be added to the back
     // of unscored_students.
-    // If a student has more than one score, the last one will be taken
+    // If a student has more than one score, the last one will be taken.
+    // IDs of students not in the course will be added to the back of
+    // not_enrolled, their scores are ignored.
     bool RecordFinalScore(const Course::IDType &course_id,
                           const FinalScore &final_score,
-                          std::vector<Student::IDType> &unscored_students);
+                          std::vector<Student::IDType> &unscored_students,
+                          std::vector<Student::IDType> &not_enrolled);
+    // The same for final_score already sorted by SortFinalScore()
+    bool MergeFinalScore(const Course::IDType &course_id,
+                         const FinalScore &final_score,
+                         std::vector<Student::IDType> &unscored_students,
+                         std::vector<Student::IDType> &not_enrolled);
 
     // Set all the scores to kInvalidScore
     void RemoveFinalScore(const Course::IDType &course_id);
@@ -118,22 +197,152 @@ class Manager
                      const Course::IDType &course_id,
                      ScoreType new_score);
 
-    // accessors
-    StudentIterator student_begin() const
-    { return StudentIterator(students_.cbegin()); }
+    // ========================= Credits and GPA =========================
+    // The credits and GPA of every student (Student::total_credit() and
+    // Student::gpa()) are kept up to date by every change.
+    // Work them out again from the rosters: return false if those of any
+    // student differ, and add their IDs to the back of wrong if given.
+    bool CheckCredits(std::vector<Student::IDType> *wrong = nullptr) const;
+
+    // Students ranked by GPA, brought up to date with the students changed
+    // since the last call, so every change costs O(log n) once.
+    const GpaRanking & Ranking();
+
+    // ========================= Operations for loading =========================
+    // Make room for this many students/courses in total
+    void Reserve(std::size_t student_num, std::size_t course_num)
+    {
+        students_.Reserve(student_num);
+        courses_.Reserve(course_num);
+    }
+
+    // A roster as read from a file: (student ID, score) in file order
+    typedef std::pair<CourseHandle, FinalScore> SavedRoster;
+
+    // Trusted bulk path for loading, with the same result as calling
+    // AddStudentToCourse and then ChangeScore for every piece in order (so
+    // the last score of a student wins, and a course may appear more than
+    // once). Each course is sorted once, students are checked in bulk, and
+    // the enrollment index is rebuilt in a single pass at the end.
+    // Courses shall be valid handles. Unknown students are skipped. If
+    // check_capacity is false, the capacity is ignored (trusted snapshots).
+    // rosters will be reordered.
+    void LoadRosters(std::vector<SavedRoster> &rosters, bool check_capacity,
+                     RosterLoadSummary &summary);
+
+    // Rebuild the enrollment index in one pass, better done after loading
+    void CompactEnrollment() { enrollment_.Compact(); }
+
+    // ========================= Dirty tracking =========================
+    // Every change marks the departments of the students and courses it
+    // touches, removed ones included. A changed roster marks its course, so
+    // a new student ID marks every course of the student. Savers write the
+    // departments marked since they last called ClearDirty().
+    const std::set<int> & dirty_departments() const
+    { return dirty_departments_; }
+    void ClearDirty() { dirty_departments_.clear(); }
+
+    // accessors, students and courses are iterated in ID order
+    StudentIterator student_begin() const { return students_.begin(); }
+    StudentIterator student_end() const { return students_.end(); }
+
+    CourseIterator course_begin() const { return courses_.begin(); }
+    CourseIterator course_end() const { return courses_.end(); }
+
+    std::size_t StudentNumber() const { return students_.size(); }
+    std::size_t CourseNumber() const { return courses_.size(); }
+
+ private:
+    friend class Batch;
+
+    void MarkDirty(int department) { dirty_departments_.insert(department); }
+    // also for the ranking, as its ID or department may have changed
+    void MarkStudent(StudentHandle student)
+    {
+        MarkDirty(students_[student].info().department);
+        ranking_changes_.insert(student);
+    }
+    void MarkCourse(CourseHandle course)
+    { MarkDirty(courses_[course].info().department); }
+    // every course the student takes
+    void MarkCoursesOf(StudentHandle student);
+
+    StudentStore students_;
+    CourseStore courses_;
+    EnrollmentIndex enrollment_;
+    std::set<std::pair<CourseKey, CourseHandle>> semester_index_;
+
+    std::set<int> dirty_departments_;
+
+    GpaRanking ranking_;
+    std::set<StudentHandle> ranking_changes_;  // besides credit changes
+};
+
+// Record many edits of a manager and apply them all at once.
+// Every edit is checked when recorded, as if the edits before it had been
+// applied, and returns false if it would fail. The manager itself is not
+// touched until Commit(), which applies every edit in one pass if all of
+// them are valid, or nothing at all otherwise.
+class Manager::Batch
+{
+ public:
+    explicit Batch(Manager &manager);
 
-    StudentIterator student_end() const
-    { return StudentIterator(students_.cend()); }
+    bool AddStudent(const StudentInfo &info);
+    bool AddCourse(const CourseInfo &info);
+    bool AddStudentToCourse(Student::IDType student_id,
+                            const Course::IDType &course_id);
+    bool ChangeScore(Student::IDType student_id,
+                     const Course::IDType &course_id,
+                     ScoreType new_score);
+    bool SetStudentInfo(Student::IDType student_id, const StudentInfo &info);
 
-    CourseIterator course_begin() const
-    { return CourseIterator(courses_.cbegin()); }
+    // Return false (and change nothing) if any edit is invalid.
+    // The batch will be empty afterwards.
+    bool Commit();
+    void Clear();
 
-    CourseIterator course_end() const
-    { return CourseIterator(courses_.cend()); }
+    // number of edits recorded
+    std::size_t size() const { return edit_num_; }
+    // index of the first invalid edit, size() if all of them are valid
+    std::size_t first_failure() const { return first_failure_; }
 
  private:
-    std::map<Student::IDType, Student> students_;
-    std::map<Course::IDType, Course> courses_;
+    // Reference to a student/course: the handle of an existing one, or
+    // kNewItem + index for one added by this batch.
+    typedef std::uint64_t Ref;
+    static const Ref kNewItem = 1ULL << 32;
+    static const Ref kNoItem = ~0ULL;
+
+    struct ScoreEdit
+    {
+        Ref student;
+        Ref course;
+        ScoreType score;
+    };
+
+    Ref FindStudent(Student::IDType student_id) const;
+    Ref FindCourse(const Course::IDType &course_id) const;
+    bool IsEnrolled(Ref student, Ref course) const;
+    bool Record(bool valid);
+
+    Manager &manager_;
+
+    std::vector<StudentInfo> new_students_;
+    std::vector<CourseInfo> new_courses_;
+    // student IDs whose owner has been changed by this batch
+    std::unordered_map<Student::IDType, Ref> student_ids_;
+    std::unordered_map<Course::IDType, Ref> course_ids_;
+    // existing students with new info, and ID changes in recorded order
+    std::unordered_map<StudentHandle, StudentInfo> changed_students_;
+    std::vector<std::pair<StudentHandle, Student::IDType>> renames_;
+
+    std::set<std::pair<Ref, Ref>> enrollments_;  // (student, course)
+    std::unordered_map<Ref, std::size_t> roster_growth_;
+    std::vector<ScoreEdit> scores_;
+
+    std::size_t edit_num_;
+    std::size_t first_failure_;
 };
 
 }  // namespace SAM
@@ -0,0 +1,511 @@
+#include <cstring>
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+#if !defined(_WIN32) && (defined(__unix__) || defined(__unix) || (defined(__APPLE__) && defined(__MACH__)))
+
+#ifndef UNIX_LIKE_SYS
+#define UNIX_LIKE_SYS
+#endif
+
+#include <unistd.h>
+
+#endif
+
+#include "atomic_file.h"
+#include "mutation_log.h"
+#include "segmented_snapshot.h"
+#include "text_parser.h"
+
+namespace SAM {
+
+const std::uint64_t MutationLog::kCheckpointSize;
+
+namespace {
+
+const char kLogHeader[] = "SAM-LOG 1\n";
+const std::size_t kLogHeaderSize = sizeof(kLogHeader) - 1;
+
+// every float survives the round trip
+const int kScorePrecision = 9;
+
+// FNV-1a, enough to tell a torn group from a complete one
+std::uint64_t Checksum(const char *begin, const char *end)
+{
+    std::uint64_t hash = 14695981039346656037ULL;
+    for (const char *p = begin; p != end; ++p)
+    {
+        hash ^= static_cast<unsigned char>(*p);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// Apply the records of committed groups to a manager (never null when
+// ApplyGroup() is called)
+class Replayer
+{
+ public:
+    explicit Replayer(Manager *manager)
+            : manager_(manager), id_map_(), failed_num_(0) {}
+
+    void ApplyGroup(const char *begin, const char *end);
+    std::size_t failed_num() const { return failed_num_; }
+
+ private:
+    bool Apply(TextParser &parser, const std::string &command);
+    void FlushRenumber();
+
+    Manager *manager_;
+    Manager::IDMap id_map_;  // consecutive renumber records go together
+    std::size_t failed_num_;
+};
+
+void Replayer::ApplyGroup(const char *begin, const char *end)
+{
+    TextParser parser(begin, end);
+    while (parser.NextNonBlankLine())
+    {
+        TextSpan command;
+        parser.NextField(command);
+
+        std::string name = command.str();
+        if (name != "renumber")
+            FlushRenumber();
+
+        if (!Apply(parser, name))
+            failed_num_++;
+    }
+    FlushRenumber();
+}
+
+bool Replayer::Apply(TextParser &parser, const std::string &command)
+{
+    StudentInfo student_info;
+    CourseInfo course_info;
+    std::uint64_t student_id, other_id;
+    Course::IDType course_id;
+    ScoreType score;
+
+    if (command == "add-stu")
+    {
+        return parser.ReadStudentInfo(student_info) &&
+               manager_->AddStudent(student_info);
+    }
+    else if (command == "rm-stu")
+    {
+        return parser.ReadUInt64("student ID", student_id) &&
+               manager_->RemoveStudent(student_id);
+    }
+    else if (command == "rm-cohort")
+    {
+        if (!parser.ReadUInt64("student ID", student_id) ||
+            !parser.ReadUInt64("student ID", other_id))
+            return false;
+
+        RemovalSummary summary;
+        manager_->RemoveStudents([student_id, other_id](const Student &student)
+                                 {
+                                     return student.info().id >= student_id &&
+                                            student.info().id <= other_id;
+                                 },
+                                 summary);
+        return true;
+    }
+    else if (command == "set-stu")
+    {
+        return parser.ReadUInt64("student ID", student_id) &&
+               parser.ReadStudentInfo(student_info) &&
+               manager_->SetStudentInfo(student_id, student_info);
+    }
+    else if (command == "renumber")
+    {
+        if (!parser.ReadUInt64("student ID", student_id) ||
+            !parser.ReadUInt64("student ID", other_id))
+            return false;
+
+        id_map_.emplace_back(student_id, other_id);
+        return true;
+    }
+    else if (command == "add-crs")
+    {
+        return parser.ReadCourseInfo(course_info) &&
+               manager_->AddCourse(course_info);
+    }
+    else if (command == "rm-crs")
+    {
+        return parser.ReadString("course ID", course_id) &&
+               manager_->RemoveCourse(course_id);
+    }
+    else if (command == "reg")
+    {
+        return parser.ReadUInt64("student ID", student_id) &&
+               parser.ReadString("course ID", course_id) &&
+               manager_->AddStudentToCourse(student_id, course_id);
+    }
+    else if (command == "drop")
+    {
+        return parser.ReadUInt64("student ID", student_id) &&
+               parser.ReadString("course ID", course_id) &&
+               manager_->RemoveStudentFromCourse(student_id, course_id);
+    }
+    else if (command == "ch-score")
+    {
+        return parser.ReadUInt64("student ID", student_id) &&
+               parser.ReadString("course ID", course_id) &&
+               parser.ReadScore("score", score) &&
+               manager_->ChangeScore(student_id, course_id, score);
+    }
+    else if (command == "remove-final")
+    {
+        if (!parser.ReadString("course ID", course_id) ||
+            !manager_->HasCourse(course_id))
+            return false;
+
+        manager_->RemoveFinalScore(course_id);
+        return true;
+    }
+
+    return false;
+}
+
+void Replayer::FlushRenumber()
+{
+    if (id_map_.empty())
+        return;
+
+    std::vector<RenumberConflict> conflicts;
+    if (!manager_->RenumberStudents(id_map_, conflicts))
+        failed_num_ += id_map_.size();
+    id_map_.clear();
+}
+
+}  // namespace
+
+MutationLog::MutationLog()
+        : file_name_(), file_(nullptr), size_(0), last_sequence_(0),
+          pending_(), pending_num_(0)
+{
+}
+
+MutationLog::~MutationLog()
+{
+    Close();
+}
+
+bool MutationLog::Open(const std::string &file_name,
+                       std::uint64_t base_sequence,
+                       Manager *manager,
+                       LogReplaySummary &summary)
+{
+    Close();
+    summary = LogReplaySummary{0, 0, 0, 0, false};
+    file_name_ = file_name;
+    last_sequence_ = base_sequence;
+
+    std::string text;
+    {
+        std::ifstream fin(file_name, std::ios::binary);
+        if (fin.is_open())
+        {
+            std::ostringstream oss;
+            oss << fin.rdbuf();
+            text = oss.str();
+        }
+    }
+
+    // a missing or empty file is a new log
+    if (text.empty())
+        return Reset();
+
+    if (text.compare(0, kLogHeaderSize, kLogHeader) != 0)
+        return false;
+
+    // find the committed groups, and apply the new ones
+    const char *begin = text.data();
+    const char *end = text.data() + text.size();
+    const char *group_begin = begin + kLogHeaderSize;
+    std::size_t record_num = 0;
+    std::uint64_t sequence = 0;
+    Replayer replayer(manager);
+
+    TextParser parser(group_begin, end);
+    while (parser.NextLine())
+    {
+        TextSpan command;
+        if (!parser.NextField(command) ||
+            command.str() != "commit")
+        {
+            record_num++;
+            continue;
+        }
+
+        const char *group_end = parser.line_begin();
+        std::uint64_t group_sequence, group_record_num, checksum;
+        if (!parser.ReadUInt64("sequence", group_sequence) ||
+            !parser.ReadUInt64("record number", group_record_num) ||
+            !parser.ReadUInt64("checksum", checksum) ||
+            !parser.ExpectLineEnd() ||
+            group_sequence <= sequence ||
+            group_record_num != record_num ||
+            checksum != Checksum(group_begin, group_end))
+            break;
+
+        // the commit line shall be complete, too
+        const char *next = static_cast<const char *>(
+                std::memchr(group_end, '\n', end - group_end));
+        if (!next)
+            break;
+
+        sequence = group_sequence;
+        if (sequence <= base_sequence)
+        {
+            summary.skipped_num++;
+        }
+        else if (manager)
+        {
+            replayer.ApplyGroup(group_begin, group_end);
+            summary.group_num++;
+            summary.record_num += record_num;
+        }
+
+        group_begin = next + 1;
+        record_num = 0;
+    }
+    summary.failed_num = replayer.failed_num();
+    last_sequence_ = std::max(base_sequence, sequence);
+
+    // cut off what follows the last complete group
+    std::size_t valid_size = group_begin - begin;
+    if (valid_size < text.size())
+    {
+        summary.torn = true;
+
+        AtomicFile fout;
+        if (!fout.Open(file_name))
+            return false;
+        fout.Append(text.data(), valid_size);
+        if (!fout.Commit())
+            return false;
+    }
+
+    file_ = std::fopen(file_name.c_str(), "ab");
+    if (!file_)
+        return false;
+    size_ = valid_size;
+    return true;
+}
+
+void MutationLog::Close()
+{
+    if (file_)
+    {
+        std::fclose(file_);
+        file_ = nullptr;
+    }
+    Abort();
+}
+
+void MutationLog::AddStudent(const StudentInfo &info)
+{
+    if (!file_)
+        return;
+
+    AppendStudentInfo(NewRecord("add-stu"), info);
+    pending_ += '\n';
+}
+
+void MutationLog::RemoveStudent(Student::IDType student_id)
+{
+    if (!file_)
+        return;
+
+    AppendUInt(NewRecord("rm-stu"), student_id);
+    pending_ += '\n';
+}
+
+void MutationLog::RemoveCohort(Student::IDType first, Student::IDType last)
+{
+    if (!file_)
+        return;
+
+    AppendUInt(NewRecord("rm-cohort"), first);
+    pending_ += ' ';
+    AppendUInt(pending_, last);
+    pending_ += '\n';
+}
+
+void MutationLog::SetStudentInfo(Student::IDType student_id,
+                                 const StudentInfo &info)
+{
+    if (!file_)
+        return;
+
+    AppendUInt(NewRecord("set-stu"), student_id);
+    pending_ += ' ';
+    AppendStudentInfo(pending_, info);
+    pending_ += '\n';
+}
+
+void MutationLog::RenumberStudents(const Manager::IDMap &id_map)
+{
+    if (!file_)
+        return;
+
+    for (const auto &change : id_map)
+    {
+        AppendUInt(NewRecord("renumber"), change.first);
+        pending_ += ' ';
+        AppendUInt(pending_, change.second);
+        pending_ += '\n';
+    }
+}
+
+void MutationLog::AddCourse(const CourseInfo &info)
+{
+    if (!file_)
+        return;
+
+    AppendCourseInfo(NewRecord("add-crs"), info);
+    pending_ += '\n';
+}
+
+void MutationLog::RemoveCourse(const Course::IDType &course_id)
+{
+    if (!file_)
+        return;
+
+    NewRecord("rm-crs") += course_id;
+    pending_ += '\n';
+}
+
+void MutationLog::AddStudentToCourse(Student::IDType student_id,
+                                     const Course::IDType &course_id)
+{
+    if (!file_)
+        return;
+
+    AppendUInt(NewRecord("reg"), student_id);
+    pending_ += ' ';
+    pending_ += course_id;
+    pending_ += '\n';
+}
+
+void MutationLog::RemoveStudentFromCourse(Student::IDType student_id,
+                                          const Course::IDType &course_id)
+{
+    if (!file_)
+        return;
+
+    AppendUInt(NewRecord("drop"), student_id);
+    pending_ += ' ';
+    pending_ += course_id;
+    pending_ += '\n';
+}
+
+void MutationLog::ChangeScore(Student::IDType student_id,
+                              const Course::IDType &course_id,
+                              ScoreType score)
+{
+    if (!file_)
+        return;
+
+    AppendUInt(NewRecord("ch-score"), student_id);
+    pending_ += ' ';
+    pending_ += course_id;
+    pending_ += ' ';
+    AppendScore(pending_, score, kScorePrecision);
+    pending_ += '\n';
+}
+
+void MutationLog::RemoveFinalScore(const Course::IDType &course_id)
+{
+    if (!file_)
+        return;
+
+    NewRecord("remove-final") += course_id;
+    pending_ += '\n';
+}
+
+bool MutationLog::Commit()
+{
+    if (pending_num_ == 0)  // nothing is recorded unless open
+        return true;
+
+    std::uint64_t checksum = Checksum(pending_.data(),
+                                      pending_.data() + pending_.size());
+    pending_ += "commit ";
+    AppendUInt(pending_, last_sequence_ + 1);
+    pending_ += ' ';
+    AppendUInt(pending_, pending_num_);
+    pending_ += ' ';
+    AppendUInt(pending_, checksum);
+    pending_ += '\n';
+
+    bool ok = std::fwrite(pending_.data(), 1, pending_.size(), file_) ==
+                  pending_.size() &&
+              std::fflush(file_) == 0;
+#ifdef UNIX_LIKE_SYS
+    ok = ok && ::fsync(::fileno(file_)) == 0;
+#endif
+
+    if (!ok)
+    {
+        // What follows a torn group would be cut off with it, so stop
+        // here. Saving again starts a new log.
+        Close();
+        return false;
+    }
+
+    last_sequence_++;
+    size_ += pending_.size();
+    Abort();
+    return true;
+}
+
+void MutationLog::Abort()
+{
+    pending_.clear();
+    pending_num_ = 0;
+}
+
+bool MutationLog::Checkpoint(SegmentedSnapshot &snapshot, Manager &manager)
+{
+    if (!file_ || !Commit() || !snapshot.Write(manager, last_sequence_))
+        return false;
+
+    manager.ClearDirty();
+    return Reset();
+}
+
+std::string & MutationLog::NewRecord(const char *command)
+{
+    pending_ += command;
+    pending_ += ' ';
+    pending_num_++;
+    return pending_;
+}
+
+bool MutationLog::Reset()
+{
+    if (file_)
+    {
+        std::fclose(file_);
+        file_ = nullptr;
+    }
+
+    AtomicFile fout;
+    if (!fout.Open(file_name_))
+        return false;
+    fout.Append(kLogHeader, kLogHeaderSize);
+    if (!fout.Commit())
+        return false;
+
+    file_ = std::fopen(file_name_.c_str(), "ab");
+    size_ = kLogHeaderSize;
+    return file_ != nullptr;
+}
+
+}  // namespace SAM
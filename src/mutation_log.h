@@ -0,0 +1,113 @@
+#ifndef SAM_MUTATION_LOG_H_
+#define SAM_MUTATION_LOG_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+#include <string>
+
+#include "manager.h"
+
+namespace SAM {
+
+class SegmentedSnapshot;
+
+// What MutationLog::Open has found in an existing log
+struct LogReplaySummary
+{
+    std::size_t group_num;     // groups applied to the manager
+    std::size_t record_num;    // records in them
+    std::size_t failed_num;    // records the manager refused
+    std::size_t skipped_num;   // groups already in the snapshot
+    bool torn;                 // an unfinished group was cut off
+};
+
+// Append-only log of the edits made to a Manager since the last snapshot,
+// so that saving costs as much as the edits, not as the whole data.
+//
+// Records are text lines, a superset of what ManagerReader::ReadBatch
+// reads. They are kept in memory until Commit(), which appends them as one
+// group with a single write and fsync:
+//
+//     SAM-LOG 1
+//     <record>...
+//     commit <sequence> <record number> <checksum>
+//
+// Sequence numbers grow by one per group. A group whose commit line is
+// missing or does not match (a crash in the middle of Commit) is cut off
+// when the log is opened again. A snapshot records the last sequence it
+// contains, so after a crash between writing it and emptying the log,
+// the groups already folded in are skipped.
+class MutationLog
+{
+ public:
+    MutationLog();
+    ~MutationLog();
+    MutationLog(const MutationLog &) = delete;
+    MutationLog & operator=(const MutationLog &) = delete;
+
+    // Open file_name for appending, creating it if needed. Groups in it
+    // after base_sequence (that of the snapshot loaded) are applied to
+    // manager first, unless it is null. Return false if the file cannot be
+    // read or written, or is not a log.
+    bool Open(const std::string &file_name, std::uint64_t base_sequence,
+              Manager *manager, LogReplaySummary &summary);
+    void Close();  // pending records are dropped
+    bool is_open() const { return file_ != nullptr; }
+
+    // Records are ignored unless the log is open.
+    // Only edits the manager has accepted shall be recorded.
+    void AddStudent(const StudentInfo &info);
+    void RemoveStudent(Student::IDType student_id);
+    void RemoveCohort(Student::IDType first, Student::IDType last);
+    void SetStudentInfo(Student::IDType student_id, const StudentInfo &info);
+    void RenumberStudents(const Manager::IDMap &id_map);
+
+    void AddCourse(const CourseInfo &info);
+    void RemoveCourse(const Course::IDType &course_id);
+
+    void AddStudentToCourse(Student::IDType student_id,
+                            const Course::IDType &course_id);
+    void RemoveStudentFromCourse(Student::IDType student_id,
+                                 const Course::IDType &course_id);
+    void ChangeScore(Student::IDType student_id,
+                     const Course::IDType &course_id, ScoreType score);
+    void RemoveFinalScore(const Course::IDType &course_id);
+
+    // Write the pending records as one group, and make it durable.
+    // Return false if it cannot be written (the records are dropped).
+    bool Commit();
+    // Drop the pending records, e.g. of a batch that failed
+    void Abort();
+
+    // Fold the log into the snapshot (only the departments it has changed,
+    // once the snapshot is in sync), clear the dirty marks of manager, then
+    // start an empty log
+    bool Checkpoint(SegmentedSnapshot &snapshot, Manager &manager);
+
+    // Better fold the log when replaying it costs more than this
+    bool NeedsCheckpoint() const { return size_ >= kCheckpointSize; }
+
+    std::uint64_t size() const { return size_; }  // in bytes, committed
+    std::uint64_t last_sequence() const { return last_sequence_; }
+    std::size_t pending_num() const { return pending_num_; }
+
+ private:
+    static const std::uint64_t kCheckpointSize = 8 << 20;
+
+    std::string & NewRecord(const char *command);
+    bool Reset();  // replace the file with an empty log
+
+    std::string file_name_;
+    std::FILE *file_;
+    std::uint64_t size_;
+    std::uint64_t last_sequence_;
+
+    std::string pending_;  // records not committed yet
+    std::size_t pending_num_;
+};
+
+}  // namespace SAM
+
+#endif  // SAM_MUTATION_LOG_H_
@@ -0,0 +1,50 @@
+#ifndef SAM_PARALLEL_H_
+#define SAM_PARALLEL_H_
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+namespace SAM {
+
+typedef std::chrono::steady_clock Clock;
+
+inline double SecondsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// The number of threads a job runs on, the number of cores by default
+class ThreadCount
+{
+ public:
+    unsigned thread_num() const { return thread_num_; }
+    void set_thread_num(unsigned thread_num)
+    { thread_num_ = std::max(1u, thread_num); }
+
+ protected:
+    ThreadCount()
+            : thread_num_(std::max(1u, std::thread::hardware_concurrency()))
+    {
+    }
+
+    unsigned thread_num_;
+};
+
+// work(index) for every index below thread_num, each on a thread of its
+// own, index 0 on this one. Return once all of them are done.
+template <typename Work>
+void RunOnThreads(unsigned thread_num, Work work)
+{
+    std::vector<std::thread> workers;
+    for (unsigned index = 1; index < thread_num; index++)
+        workers.emplace_back(work, index);
+    work(0u);
+    for (std::thread &worker : workers)
+        worker.join();
+}
+
+}  // namespace SAM
+
+#endif  // SAM_PARALLEL_H_
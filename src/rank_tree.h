@@ -0,0 +1,220 @@
+#ifndef SAM_RANK_TREE_H_
+#define SAM_RANK_TREE_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include <functional>
+#include <utility>
+#include <vector>
+
+namespace SAM {
+
+// A set of distinct keys that can also be looked up by rank (the number of
+// keys before it), all in O(log n) expected time.
+// It is a treap whose nodes count the keys below them. The nodes are kept
+// in a vector and refer to each other by index, freed ones are reused.
+template <typename KeyType, typename Compare = std::less<KeyType>>
+class RankTree
+{
+ public:
+    explicit RankTree(const Compare &compare = Compare())
+            : nodes_(), free_(), root_(kNil), compare_(compare),
+              random_state_(0x9E3779B9u) {}
+
+    std::size_t size() const { return Size(root_); }
+    bool empty() const { return root_ == kNil; }
+
+    // Return false if the key is already in
+    bool Insert(const KeyType &key)
+    {
+        if (Contains(key))
+            return false;
+
+        Index less, rest;
+        Split(root_, key, false, less, rest);
+        root_ = Merge(Merge(less, NewNode(key)), rest);
+        return true;
+    }
+
+    // Return false if the key is not in
+    bool Erase(const KeyType &key)
+    {
+        Index less, rest, equal, greater;
+        Split(root_, key, false, less, rest);
+        Split(rest, key, true, equal, greater);
+        if (equal != kNil)  // a single node, the keys are distinct
+            free_.push_back(equal);
+        root_ = Merge(less, greater);
+        return equal != kNil;
+    }
+
+    bool Contains(const KeyType &key) const
+    {
+        Index node = root_;
+        while (node != kNil)
+        {
+            if (compare_(key, nodes_[node].key))
+                node = nodes_[node].left;
+            else if (compare_(nodes_[node].key, key))
+                node = nodes_[node].right;
+            else
+                return true;
+        }
+        return false;
+    }
+
+    // The number of keys before key / not after key
+    std::size_t CountBefore(const KeyType &key) const
+    { return Count(key, false); }
+    std::size_t CountNotAfter(const KeyType &key) const
+    { return Count(key, true); }
+
+    // The key with rank keys before it, rank shall be less than size()
+    const KeyType & Select(std::size_t rank) const
+    {
+        Index node = root_;
+        while (true)
+        {
+            std::size_t left_size = Size(nodes_[node].left);
+            if (rank < left_size)
+            {
+                node = nodes_[node].left;
+            }
+            else if (rank == left_size)
+            {
+                return nodes_[node].key;
+            }
+            else
+            {
+                rank -= left_size + 1;
+                node = nodes_[node].right;
+            }
+        }
+    }
+
+    void Clear()
+    {
+        nodes_.clear();
+        free_.clear();
+        root_ = kNil;
+    }
+
+ private:
+    typedef std::uint32_t Index;
+    static const Index kNil = 0xFFFFFFFFu;
+
+    struct Node
+    {
+        KeyType key;
+        std::uint32_t priority;
+        Index left;
+        Index right;
+        std::uint32_t size;  // of the subtree
+    };
+
+    std::size_t Size(Index node) const
+    { return node == kNil ? 0 : nodes_[node].size; }
+
+    void Update(Index node)
+    {
+        nodes_[node].size = static_cast<std::uint32_t>(
+                1 + Size(nodes_[node].left) + Size(nodes_[node].right));
+    }
+
+    Index NewNode(const KeyType &key)
+    {
+        // xorshift, the priorities only need to look random
+        random_state_ ^= random_state_ << 13;
+        random_state_ ^= random_state_ >> 17;
+        random_state_ ^= random_state_ << 5;
+        Node node{key, random_state_, kNil, kNil, 1};
+
+        if (free_.empty())
+        {
+            nodes_.push_back(node);
+            return static_cast<Index>(nodes_.size() - 1);
+        }
+        Index index = free_.back();
+        free_.pop_back();
+        nodes_[index] = node;
+        return index;
+    }
+
+    // Split the subtree into the keys before key (not after key if
+    // inclusive) and the others
+    void Split(Index node, const KeyType &key, bool inclusive,
+               Index &left, Index &right)
+    {
+        if (node == kNil)
+        {
+            left = right = kNil;
+            return;
+        }
+
+        bool goes_left = inclusive ? !compare_(key, nodes_[node].key)
+                                   : compare_(nodes_[node].key, key);
+        if (goes_left)
+        {
+            Split(nodes_[node].right, key, inclusive, nodes_[node].right,
+                  right);
+            left = node;
+        }
+        else
+        {
+            Split(nodes_[node].left, key, inclusive, left, nodes_[node].left);
+            right = node;
+        }
+        Update(node);
+    }
+
+    // Every key of left shall be before those of right
+    Index Merge(Index left, Index right)
+    {
+        if (left == kNil)
+            return right;
+        if (right == kNil)
+            return left;
+
+        if (nodes_[left].priority > nodes_[right].priority)
+        {
+            nodes_[left].right = Merge(nodes_[left].right, right);
+            Update(left);
+            return left;
+        }
+        nodes_[right].left = Merge(left, nodes_[right].left);
+        Update(right);
+        return right;
+    }
+
+    std::size_t Count(const KeyType &key, bool inclusive) const
+    {
+        std::size_t count = 0;
+        Index node = root_;
+        while (node != kNil)
+        {
+            bool counted = inclusive ? !compare_(key, nodes_[node].key)
+                                     : compare_(nodes_[node].key, key);
+            if (counted)
+            {
+                count += Size(nodes_[node].left) + 1;
+                node = nodes_[node].right;
+            }
+            else
+            {
+                node = nodes_[node].left;
+            }
+        }
+        return count;
+    }
+
+    std::vector<Node> nodes_;
+    std::vector<Index> free_;
+    Index root_;
+    Compare compare_;
+    std::uint32_t random_state_;
+};
+
+}  // namespace SAM
+
+#endif  // SAM_RANK_TREE_H_
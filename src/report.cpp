@@ -0,0 +1,319 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+
+#include "atomic_file.h"
+#include "report.h"
+#include "score_kernels.h"
+
+namespace SAM {
+
+namespace {
+
+const std::size_t kCoursesPerChunk = 16;
+// so that spreadsheets take the file as UTF-8
+const char *kUtf8Bom = "\xEF\xBB\xBF";
+
+// Each field is followed by a comma, which EndLine() turns into a newline
+void AppendText(std::string &out, const std::string &text)
+{
+    if (text.find_first_of(",\"\r\n") == std::string::npos)
+    {
+        out += text;
+    }
+    else
+    {
+        out += '"';
+        for (char c : text)
+        {
+            if (c == '"')
+                out += '"';
+            out += c;
+        }
+        out += '"';
+    }
+    out += ',';
+}
+
+void AppendNumber(std::string &out, double value, int precision)
+{
+    char field[32];
+    std::snprintf(field, sizeof(field), "%.*f,", precision, value);
+    out += field;
+}
+
+// left empty for kInvalidScore
+void AppendScore(std::string &out, ScoreType score)
+{
+    if (score == kInvalidScore)
+    {
+        out += ',';
+        return;
+    }
+    char field[32];
+    std::snprintf(field, sizeof(field), "%g,", score);
+    out += field;
+}
+
+void EndLine(std::string &out)
+{
+    out.back() = '\n';
+}
+
+void AppendAggregateHeading(std::string &out)
+{
+    AppendText(out, "成绩数");
+    AppendText(out, "平均分");
+    AppendText(out, "标准差");
+    AppendText(out, "最低分");
+    for (std::size_t index = 0; index < ScoreAggregate::kQuantileNum; index++)
+    {
+        if (index == ScoreAggregate::kMedian)
+        {
+            AppendText(out, "中位数");
+            continue;
+        }
+        int percent = static_cast<int>(
+                std::lround(ScoreAggregate::kQuantiles[index] * 100));
+        AppendText(out, std::to_string(percent) + "%分位数");
+    }
+    AppendText(out, "最高分");
+    AppendText(out, "及格率(%)");
+
+    const std::size_t width = CourseStatistics::kBucketWidth;
+    for (std::size_t bucket = 0;
+         bucket + 1 < CourseStatistics::kBucketNum;
+         bucket++)
+    {
+        AppendText(out, std::to_string(bucket * width) + '-' +
+                        std::to_string(bucket * width + width - 1));
+    }
+    AppendText(out, std::to_string((CourseStatistics::kBucketNum - 1) * width));
+}
+
+void AppendAggregate(std::string &out, const ScoreAggregate &scores)
+{
+    AppendText(out, std::to_string(scores.score_num));
+    AppendNumber(out, scores.mean, 2);
+    AppendNumber(out, scores.stddev, 2);
+    AppendScore(out, scores.min_score);
+    for (ScoreType quantile : scores.quantiles)
+        AppendScore(out, quantile);
+    AppendScore(out, scores.max_score);
+    AppendNumber(out, scores.pass_rate * 100, 2);
+    for (std::size_t count : scores.histogram)
+        AppendText(out, std::to_string(count));
+}
+
+}  // namespace
+
+const std::size_t ScoreAggregate::kQuantileNum;
+const double ScoreAggregate::kQuantiles[kQuantileNum] = {
+    0.1, 0.25, 0.5, 0.75, 0.9
+};
+const std::size_t ScoreAggregate::kMedian;
+
+constexpr ScoreType Report::kPassScore;
+
+Report::Report()
+        : departments_(),
+          courses_(),
+          seconds_(0)
+{
+}
+
+ScoreAggregate Report::Aggregate(const std::vector<ScoreType> &sorted)
+{
+    ScoreSummary summary = SummarizeScores(sorted.data(), sorted.size());
+
+    ScoreAggregate scores;
+    scores.score_num = summary.count;
+    scores.mean = summary.mean();
+    scores.stddev = std::sqrt(summary.variance());
+    scores.min_score = summary.min_score;
+    scores.max_score = summary.max_score;
+    scores.histogram.fill(0);
+
+    if (sorted.empty())
+    {
+        scores.pass_rate = 0;
+        for (ScoreType &quantile : scores.quantiles)
+            quantile = kInvalidScore;
+        return scores;
+    }
+
+    auto pass = std::lower_bound(sorted.begin(), sorted.end(), kPassScore);
+    scores.pass_rate = double(sorted.end() - pass) / sorted.size();
+
+    for (std::size_t index = 0; index < ScoreAggregate::kQuantileNum; index++)
+    {
+        // the smallest score with at least this share of them not above it
+        double rank = std::ceil(ScoreAggregate::kQuantiles[index] *
+                                sorted.size());
+        std::size_t position = rank > 1 ? static_cast<std::size_t>(rank) - 1
+                                        : 0;
+        scores.quantiles[index] = sorted[position];
+    }
+
+    for (ScoreType score : sorted)
+        scores.histogram[CourseStatistics::BucketOf(score)]++;
+
+    return scores;
+}
+
+void Report::Build(const Manager &manager)
+{
+    Clock::time_point start = Clock::now();
+
+    std::vector<CourseHandle> handles;
+    for (auto iter = manager.course_begin(); iter != manager.course_end();
+         ++iter)
+        handles.push_back(iter.handle());
+    manager.SortByCourseID(handles);
+    courses_.assign(handles.size(), CourseRow());
+
+    // the scores of each department, as gathered by each worker
+    typedef std::vector<std::vector<ScoreType>> Gathered;
+    std::vector<Gathered> gathered(thread_num_, Gathered(kDepartmentNum));
+
+    std::atomic<std::size_t> next_course(0);
+    RunOnThreads(thread_num_, [&](unsigned worker)
+    {
+        Gathered &department_scores = gathered[worker];
+        for (std::size_t begin = next_course.fetch_add(kCoursesPerChunk);
+             begin < handles.size();
+             begin = next_course.fetch_add(kCoursesPerChunk))
+        {
+            std::size_t end = std::min(handles.size(),
+                                       begin + kCoursesPerChunk);
+            for (std::size_t index = begin; index < end; index++)
+            {
+                const Course &course = manager.course(handles[index]);
+                RosterView roster = course.final_score();
+
+                CourseRow &row = courses_[index];
+                row.info = course.info();
+                row.student_num = roster.size();
+                row.scores = Aggregate(course.statistics()->sorted_scores());
+
+                for (std::size_t at = 0; at < roster.size(); at++)
+                {
+                    ScoreType score = roster.scores()[at];
+                    if (score == kInvalidScore || score != score)
+                        continue;
+                    int department =
+                            manager.student(roster.students()[at])
+                                   .info().department;
+                    if (department >= 0 && department < kDepartmentNum)
+                        department_scores[department].push_back(score);
+                }
+            }
+        }
+    });
+
+    departments_.assign(kDepartmentNum, DepartmentRow());
+    std::atomic<int> next_department(0);
+    RunOnThreads(thread_num_, [&](unsigned)
+    {
+        for (int department = next_department++;
+             department < kDepartmentNum;
+             department = next_department++)
+        {
+            std::size_t size = 0;
+            for (const Gathered &department_scores : gathered)
+                size += department_scores[department].size();
+
+            std::vector<ScoreType> scores;
+            scores.reserve(size);
+            for (Gathered &department_scores : gathered)
+            {
+                std::vector<ScoreType> &part = department_scores[department];
+                scores.insert(scores.end(), part.begin(), part.end());
+                std::vector<ScoreType>().swap(part);  // no longer needed
+            }
+            std::sort(scores.begin(), scores.end());
+            departments_[department].scores = Aggregate(scores);
+        }
+    });
+
+    for (auto iter = manager.student_begin(); iter != manager.student_end();
+         ++iter)
+    {
+        int department = iter->info().department;
+        if (department >= 0 && department < kDepartmentNum)
+            departments_[department].student_num++;
+    }
+    for (const CourseRow &row : courses_)
+    {
+        if (row.info.department >= 0 && row.info.department < kDepartmentNum)
+            departments_[row.info.department].course_num++;
+    }
+
+    seconds_ = SecondsSince(start);
+}
+
+bool Report::WriteDepartments(const std::string &file_name) const
+{
+    AtomicFile fout;
+    if (!fout.Open(file_name))
+        return false;
+
+    std::string &out = fout.buffer();
+    out += kUtf8Bom;
+    AppendText(out, "编号");
+    AppendText(out, "院系");
+    AppendText(out, "学生数");
+    AppendText(out, "开课数");
+    AppendAggregateHeading(out);
+    EndLine(out);
+
+    for (int department = 0; department < kDepartmentNum; department++)
+    {
+        const DepartmentRow &row = departments_[department];
+        AppendText(out, std::to_string(department));
+        AppendText(out, kDepartmentName[department]);
+        AppendText(out, std::to_string(row.student_num));
+        AppendText(out, std::to_string(row.course_num));
+        AppendAggregate(out, row.scores);
+        EndLine(out);
+    }
+
+    return fout.Commit();
+}
+
+bool Report::WriteCourses(const std::string &file_name) const
+{
+    AtomicFile fout;
+    if (!fout.Open(file_name))
+        return false;
+
+    std::string &out = fout.buffer();
+    out += kUtf8Bom;
+    AppendText(out, "课程号");
+    AppendText(out, "课程名");
+    AppendText(out, "院系");
+    AppendText(out, "学分");
+    AppendText(out, "选课人数");
+    AppendAggregateHeading(out);
+    EndLine(out);
+
+    for (const CourseRow &row : courses_)
+    {
+        int department = row.info.department;
+        AppendText(out, row.info.id);
+        AppendText(out, row.info.name);
+        AppendText(out, department >= 0 && department < kDepartmentNum ?
+                            kDepartmentName[department] :
+                            std::to_string(department));
+        AppendText(out, std::to_string(row.info.credit));
+        AppendText(out, std::to_string(row.student_num));
+        AppendAggregate(out, row.scores);
+        EndLine(out);
+        fout.MaybeFlush();
+    }
+
+    return fout.Commit();
+}
+
+}  // namespace SAM
@@ -0,0 +1,90 @@
+#ifndef SAM_REPORT_H_
+#define SAM_REPORT_H_
+
+#include <cstddef>
+
+#include <string>
+#include <vector>
+
+#include "common.h"
+#include "course_statistics.h"
+#include "manager.h"
+#include "parallel.h"
+
+namespace SAM {
+
+// What a report says about a set of scores, invalid ones left out
+struct ScoreAggregate
+{
+    // the quantiles reported, the median among them
+    static const std::size_t kQuantileNum = 5;
+    static const double kQuantiles[kQuantileNum];
+    static const std::size_t kMedian = 2;
+
+    std::size_t score_num;
+    double mean;  // 0 if there is no score
+    double stddev;  // of the population
+    double pass_rate;  // share of the scores not below Report::kPassScore
+    // kInvalidScore if there is no score
+    ScoreType min_score;
+    ScoreType max_score;
+    ScoreType quantiles[kQuantileNum];  // by nearest rank
+    CourseStatistics::Histogram histogram;
+
+    ScoreType median() const { return quantiles[kMedian]; }
+};
+
+// Scores of every department and every course, for the weekly reports.
+// A department is reported on the scores its students got, whoever
+// offered the course. Students of departments not in kDepartmentName
+// count for their courses only.
+// Build() is one pass over the rosters on up to thread_num() threads (the
+// number of cores by default): each worker takes courses a chunk at a time
+// and keeps the scores of every department apart, and the departments are
+// then worked out in parallel from what the workers gathered.
+class Report : public ThreadCount
+{
+ public:
+    static constexpr ScoreType kPassScore = 60;
+
+    struct DepartmentRow
+    {
+        std::size_t student_num;
+        std::size_t course_num;  // offered by the department
+        ScoreAggregate scores;
+    };
+
+    struct CourseRow
+    {
+        CourseInfo info;
+        std::size_t student_num;  // taking the course
+        ScoreAggregate scores;
+    };
+
+    Report();
+
+    void Build(const Manager &manager);
+
+    // As CSV, one row per department (by number) / course (by ID), replacing
+    // the file only once complete. Return false if it cannot be written.
+    bool WriteDepartments(const std::string &file_name) const;
+    bool WriteCourses(const std::string &file_name) const;
+
+    // by the last Build()
+    const std::vector<DepartmentRow> & departments() const  // kDepartmentNum
+    { return departments_; }
+    const std::vector<CourseRow> & courses() const { return courses_; }
+    double seconds() const { return seconds_; }
+
+    // Aggregate valid scores in ascending order
+    static ScoreAggregate Aggregate(const std::vector<ScoreType> &sorted);
+
+ private:
+    std::vector<DepartmentRow> departments_;
+    std::vector<CourseRow> courses_;
+    double seconds_;
+};
+
+}  // namespace SAM
+
+#endif  // SAM_REPORT_H_
@@ -0,0 +1,209 @@
+#include <cmath>
+#include <cstring>
+
+#include <algorithm>
+#include <limits>
+
+#include "roster_codec.h"
+
+namespace SAM {
+
+static_assert(sizeof(ScoreType) == 4 &&
+              std::numeric_limits<ScoreType>::is_iec559,
+              "exceptions are stored as IEEE single precision");
+
+namespace {
+
+// The score of every code, exceptions are patched afterwards
+struct ScoreTable
+{
+    ScoreTable()
+    {
+        for (int code = 0; code < 256; code++)
+            scores[code] = (code <= kMaxScoreCode ? code * 0.5f
+                                                  : kInvalidScore);
+    }
+
+    ScoreType scores[256];
+};
+
+const ScoreTable kScoreTable;
+
+std::uint8_t ScoreCode(ScoreType score)
+{
+    if (score == kInvalidScore)
+        return kInvalidScoreCode;
+
+    ScoreType twice = score * 2;  // exact for every score a code stands for
+    if (score >= 0 && !std::signbit(score) && twice <= kMaxScoreCode &&
+        twice == std::floor(twice))
+        return static_cast<std::uint8_t>(twice);
+    return kExceptionCode;
+}
+
+void AppendVarint(std::string &out, std::uint64_t value)
+{
+    char bytes[10];
+    std::size_t size = 0;
+    while (value >= 0x80)
+    {
+        bytes[size++] = static_cast<char>((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    bytes[size++] = static_cast<char>(value);
+    out.append(bytes, size);
+}
+
+// Return false if it runs past end or does not fit in 64 bits
+inline bool ReadVarint(const unsigned char *&pos, const unsigned char *end,
+                       std::uint64_t &value)
+{
+    if (pos != end && *pos < 0x80)  // most deltas of a dense roster
+    {
+        value = *pos++;
+        return true;
+    }
+
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7)
+    {
+        if (pos == end)
+            return false;
+
+        std::uint64_t byte = *pos++;
+        if (shift == 63 && byte > 1)
+            return false;
+        value |= (byte & 0x7F) << shift;
+        if (byte < 0x80)
+            return true;
+    }
+    return false;
+}
+
+}  // namespace
+
+void PackRoster(const StudentInfo::IDType *ids, const ScoreType *scores,
+                std::size_t size, std::string &out)
+{
+    std::uint8_t codes[kRosterBlockSize];
+
+    for (std::size_t begin = 0; begin < size; begin += kRosterBlockSize)
+    {
+        std::size_t block_size = std::min(kRosterBlockSize, size - begin);
+
+        std::uint64_t exception_num = 0;
+        for (std::size_t index = 0; index < block_size; index++)
+        {
+            codes[index] = ScoreCode(scores[begin + index]);
+            if (codes[index] == kExceptionCode)
+                exception_num++;
+        }
+        AppendVarint(out, exception_num);
+
+        for (std::size_t index = begin; index < begin + block_size; index++)
+            AppendVarint(out, index == 0 ? ids[0]
+                                         : ids[index] - ids[index - 1] - 1);
+
+        out.append(reinterpret_cast<const char *>(codes), block_size);
+
+        for (std::size_t index = 0; index < block_size; index++)
+        {
+            if (codes[index] != kExceptionCode)
+                continue;
+
+            std::uint32_t bits;
+            std::memcpy(&bits, &scores[begin + index], sizeof(bits));
+            char bytes[4] = {static_cast<char>(bits),
+                             static_cast<char>(bits >> 8),
+                             static_cast<char>(bits >> 16),
+                             static_cast<char>(bits >> 24)};
+            out.append(bytes, sizeof(bytes));
+        }
+    }
+}
+
+const char * UnpackRoster(const char *begin, const char *end,
+                          std::size_t size, FinalScore &roster)
+{
+    const unsigned char *pos = reinterpret_cast<const unsigned char *>(begin);
+    const unsigned char *limit = reinterpret_cast<const unsigned char *>(end);
+
+    std::size_t first = roster.size();
+    roster.resize(first + size);
+    ScorePiece *pieces = roster.data() + first;
+
+    std::uint64_t previous = 0;
+    for (std::size_t block = 0; block < size; block += kRosterBlockSize)
+    {
+        std::size_t block_size = std::min(kRosterBlockSize, size - block);
+        ScorePiece *out = pieces + block;
+
+        std::uint64_t exception_num;
+        if (!ReadVarint(pos, limit, exception_num) ||
+            exception_num > block_size)
+            return nullptr;
+
+        for (std::size_t index = 0; index < block_size; index++)
+        {
+            std::uint64_t delta;
+            if (!ReadVarint(pos, limit, delta))
+                return nullptr;
+
+            if (block + index == 0)
+            {
+                previous = delta;
+            }
+            else
+            {
+                if (delta >= std::numeric_limits<std::uint64_t>::max() -
+                             previous)
+                    return nullptr;
+                previous += delta + 1;
+            }
+            out[index].id = previous;
+        }
+
+        if (static_cast<std::size_t>(limit - pos) <
+            block_size + exception_num * 4)
+            return nullptr;
+
+        // Check the codes first, so that the lookups below need no branch:
+        // above kMaxScoreCode there are only ever kExceptionCode and
+        // kInvalidScoreCode, anything else is a corrupted file
+        const unsigned char *codes = pos;
+        std::uint64_t exception_codes = 0;
+        std::size_t bad_codes = 0;
+        for (std::size_t index = 0; index < block_size; index++)
+        {
+            exception_codes += codes[index] == kExceptionCode;
+            bad_codes += codes[index] > kMaxScoreCode &&
+                         codes[index] < kExceptionCode;
+        }
+        if (bad_codes != 0 || exception_codes != exception_num)
+            return nullptr;
+
+        for (std::size_t index = 0; index < block_size; index++)
+            out[index].score = kScoreTable.scores[codes[index]];
+        pos += block_size;
+
+        if (exception_num != 0)
+        {
+            for (std::size_t index = 0; index < block_size; index++)
+            {
+                if (codes[index] != kExceptionCode)
+                    continue;
+
+                std::uint32_t bits = std::uint32_t(pos[0]) |
+                                     std::uint32_t(pos[1]) << 8 |
+                                     std::uint32_t(pos[2]) << 16 |
+                                     std::uint32_t(pos[3]) << 24;
+                std::memcpy(&out[index].score, &bits, sizeof(bits));
+                pos += 4;
+            }
+        }
+    }
+
+    return reinterpret_cast<const char *>(pos);
+}
+
+}  // namespace SAM
@@ -0,0 +1,45 @@
+#ifndef SAM_ROSTER_CODEC_H_
+#define SAM_ROSTER_CODEC_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include <string>
+
+#include "common.h"
+
+namespace SAM {
+
+// Compact encoding of a roster (student IDs ascending, with their scores),
+// about 3 bytes an entry instead of 12. Entries go in blocks of
+// kRosterBlockSize (the last one may be shorter):
+//
+//     varint exception_num
+//     varint id_delta[block size]    the first ID of the roster as it is,
+//                                    then (ID - previous ID - 1)
+//     uint8 score_code[block size]
+//     float exception[exception_num] little-endian, in entry order
+//
+// Score codes 0 - 250 stand for 0, 0.5, ... 125, kInvalidScoreCode for
+// kInvalidScore, kExceptionCode for the next exception of the block (any
+// other score, kept exactly). The varints are LEB128. Codes have a fixed
+// width, so once a block of them is checked, they are turned into scores
+// with one table lookup each, in a loop without branches.
+const std::size_t kRosterBlockSize = 128;
+const std::uint8_t kMaxScoreCode = 250;
+const std::uint8_t kExceptionCode = 254;
+const std::uint8_t kInvalidScoreCode = 255;
+
+// Append the encoded roster to out, ids shall be ascending
+void PackRoster(const StudentInfo::IDType *ids, const ScoreType *scores,
+                std::size_t size, std::string &out);
+
+// Decode a roster of size entries from [begin, end) to the back of roster.
+// Return where the encoded roster ends, or nullptr if it is broken (runs
+// past end, IDs not ascending); roster may have been changed then.
+const char * UnpackRoster(const char *begin, const char *end,
+                          std::size_t size, FinalScore &roster);
+
+}  // namespace SAM
+
+#endif  // SAM_ROSTER_CODEC_H_
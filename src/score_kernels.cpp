@@ -0,0 +1,238 @@
+#include <algorithm>
+#include <atomic>
+#include <limits>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SAM_HAVE_AVX2_KERNELS
+#include <immintrin.h>
+#endif
+
+#include "score_kernels.h"
+
+namespace SAM {
+
+namespace {
+
+struct KernelTable
+{
+    ScoreKernels kind;
+    ScoreSummary (*summarize)(const ScoreType *, std::size_t);
+    std::size_t (*count_above)(const ScoreType *, std::size_t, ScoreType);
+};
+
+inline bool IsValid(ScoreType score)
+{
+    return score == score && score != kInvalidScore;
+}
+
+// Fold scores[begin, size) into summary, one by one
+void SummarizeTail(const ScoreType *scores, std::size_t begin,
+                   std::size_t size, ScoreSummary &summary)
+{
+    for (std::size_t index = begin; index < size; index++)
+    {
+        ScoreType score = scores[index];
+        if (!IsValid(score))
+            continue;
+
+        summary.count++;
+        summary.min_score = std::min(summary.min_score, score);
+        summary.max_score = std::max(summary.max_score, score);
+        summary.sum += score;
+        summary.sum_of_squares += double(score) * score;
+    }
+}
+
+ScoreSummary EmptySummary()
+{
+    return ScoreSummary{0, std::numeric_limits<ScoreType>::infinity(),
+                        -std::numeric_limits<ScoreType>::infinity(), 0, 0};
+}
+
+void FinishSummary(ScoreSummary &summary)
+{
+    if (summary.count == 0)
+        summary.min_score = summary.max_score = kInvalidScore;
+}
+
+ScoreSummary SummarizeScalar(const ScoreType *scores, std::size_t size)
+{
+    ScoreSummary summary = EmptySummary();
+    SummarizeTail(scores, 0, size, summary);
+    FinishSummary(summary);
+    return summary;
+}
+
+std::size_t CountAboveScalar(const ScoreType *scores, std::size_t size,
+                             ScoreType threshold)
+{
+    std::size_t count = 0;
+    for (std::size_t index = 0; index < size; index++)
+        count += (scores[index] > threshold && IsValid(scores[index]));
+    return count;
+}
+
+const KernelTable kScalarTable = {
+    kScalarKernels, SummarizeScalar, CountAboveScalar
+};
+
+#ifdef SAM_HAVE_AVX2_KERNELS
+
+// Invalid lanes are replaced by +/-infinity for min/max and by 0 for the
+// sums, which are kept in double, 4 lanes each for the low and high half.
+__attribute__((target("avx2")))
+ScoreSummary SummarizeAvx2(const ScoreType *scores, std::size_t size)
+{
+    const __m256 invalid = _mm256_set1_ps(kInvalidScore);
+    const __m256 plus_inf =
+            _mm256_set1_ps(std::numeric_limits<ScoreType>::infinity());
+    const __m256 minus_inf = _mm256_sub_ps(_mm256_setzero_ps(), plus_inf);
+
+    __m256 min = plus_inf, max = minus_inf;
+    __m256d sum_low = _mm256_setzero_pd(), sum_high = _mm256_setzero_pd();
+    __m256d squares_low = _mm256_setzero_pd();
+    __m256d squares_high = _mm256_setzero_pd();
+    std::size_t count = 0;
+
+    std::size_t index = 0;
+    for (; index + 8 <= size; index += 8)
+    {
+        __m256 block = _mm256_loadu_ps(scores + index);
+        // false for invalid scores and NaN
+        __m256 valid = _mm256_cmp_ps(block, invalid, _CMP_NEQ_OQ);
+
+        min = _mm256_min_ps(min, _mm256_blendv_ps(plus_inf, block, valid));
+        max = _mm256_max_ps(max, _mm256_blendv_ps(minus_inf, block, valid));
+        count += __builtin_popcount(_mm256_movemask_ps(valid));
+
+        __m256 kept = _mm256_and_ps(block, valid);
+        __m256d low = _mm256_cvtps_pd(_mm256_castps256_ps128(kept));
+        __m256d high = _mm256_cvtps_pd(_mm256_extractf128_ps(kept, 1));
+        sum_low = _mm256_add_pd(sum_low, low);
+        sum_high = _mm256_add_pd(sum_high, high);
+        squares_low = _mm256_add_pd(squares_low, _mm256_mul_pd(low, low));
+        squares_high = _mm256_add_pd(squares_high,
+                                     _mm256_mul_pd(high, high));
+    }
+
+    float mins[8], maxs[8];
+    double sums[4], squares[4];
+    _mm256_storeu_ps(mins, min);
+    _mm256_storeu_ps(maxs, max);
+    _mm256_storeu_pd(sums, _mm256_add_pd(sum_low, sum_high));
+    _mm256_storeu_pd(squares, _mm256_add_pd(squares_low, squares_high));
+
+    ScoreSummary summary = EmptySummary();
+    summary.count = count;
+    for (int lane = 0; lane < 8; lane++)
+    {
+        summary.min_score = std::min(summary.min_score, mins[lane]);
+        summary.max_score = std::max(summary.max_score, maxs[lane]);
+    }
+    summary.sum = (sums[0] + sums[1]) + (sums[2] + sums[3]);
+    summary.sum_of_squares = (squares[0] + squares[1]) +
+                             (squares[2] + squares[3]);
+
+    SummarizeTail(scores, index, size, summary);
+    FinishSummary(summary);
+    return summary;
+}
+
+__attribute__((target("avx2")))
+std::size_t CountAboveAvx2(const ScoreType *scores, std::size_t size,
+                           ScoreType threshold)
+{
+    const __m256 invalid = _mm256_set1_ps(kInvalidScore);
+    const __m256 bound = _mm256_set1_ps(threshold);
+    std::size_t count = 0;
+
+    std::size_t index = 0;
+    for (; index + 8 <= size; index += 8)
+    {
+        __m256 block = _mm256_loadu_ps(scores + index);
+        __m256 above = _mm256_and_ps(
+                _mm256_cmp_ps(block, bound, _CMP_GT_OQ),
+                _mm256_cmp_ps(block, invalid, _CMP_NEQ_OQ));
+        count += __builtin_popcount(_mm256_movemask_ps(above));
+    }
+
+    return count + CountAboveScalar(scores + index, size - index, threshold);
+}
+
+const KernelTable kAvx2Table = {
+    kAvx2Kernels, SummarizeAvx2, CountAboveAvx2
+};
+
+bool HasAvx2()
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+
+#endif  // SAM_HAVE_AVX2_KERNELS
+
+const KernelTable * DetectKernels()
+{
+#ifdef SAM_HAVE_AVX2_KERNELS
+    if (HasAvx2())
+        return &kAvx2Table;
+#endif
+    return &kScalarTable;
+}
+
+std::atomic<const KernelTable *> & Kernels()
+{
+    static std::atomic<const KernelTable *> kernels(DetectKernels());
+    return kernels;
+}
+
+}  // namespace
+
+double ScoreSummary::variance() const
+{
+    if (count == 0)
+        return 0;
+
+    double average = mean();
+    return std::max(0.0, sum_of_squares / count - average * average);
+}
+
+ScoreSummary SummarizeScores(const ScoreType *scores, std::size_t size)
+{
+    return Kernels().load(std::memory_order_relaxed)->summarize(scores, size);
+}
+
+std::size_t CountAbove(const ScoreType *scores, std::size_t size,
+                       ScoreType threshold)
+{
+    return Kernels().load(std::memory_order_relaxed)->count_above(
+            scores, size, threshold);
+}
+
+ScoreKernels ActiveScoreKernels()
+{
+    return Kernels().load()->kind;
+}
+
+bool SelectScoreKernels(ScoreKernels kernels)
+{
+    switch (kernels)
+    {
+        case kScalarKernels:
+            Kernels().store(&kScalarTable);
+            return true;
+
+        case kAvx2Kernels:
+#ifdef SAM_HAVE_AVX2_KERNELS
+            if (HasAvx2())
+            {
+                Kernels().store(&kAvx2Table);
+                return true;
+            }
+#endif
+            return false;
+    }
+    return false;
+}
+
+}  // namespace SAM
@@ -0,0 +1,50 @@
+#ifndef SAM_SCORE_KERNELS_H_
+#define SAM_SCORE_KERNELS_H_
+
+#include <cstddef>
+
+#include "common.h"
+
+namespace SAM {
+
+// Scans over a column of scores, such as RosterView::scores(). kInvalidScore
+// (and NaN) is left out everywhere. The columns are scanned 8 scores at a
+// time with AVX2 where the CPU has it, otherwise one by one; which one is
+// picked on first use.
+
+struct ScoreSummary
+{
+    std::size_t count;      // of valid scores
+    ScoreType min_score;    // kInvalidScore if count is 0
+    ScoreType max_score;
+    double sum;
+    double sum_of_squares;
+
+    double mean() const { return count != 0 ? sum / count : 0; }
+    // of the population, 0 if count is 0
+    double variance() const;
+};
+
+ScoreSummary SummarizeScores(const ScoreType *scores, std::size_t size);
+
+// The number of valid scores above threshold
+std::size_t CountAbove(const ScoreType *scores, std::size_t size,
+                       ScoreType threshold);
+
+// 1 + the number of scores above score, 0 for kInvalidScore
+inline int RankOf(const ScoreType *scores, std::size_t size, ScoreType score)
+{
+    return score == kInvalidScore ?
+               0 : 1 + static_cast<int>(CountAbove(scores, size, score));
+}
+
+// Which implementation the functions above use, for benchmarks and checks
+enum ScoreKernels { kScalarKernels, kAvx2Kernels };
+ScoreKernels ActiveScoreKernels();
+// Return false (and change nothing) if this CPU cannot run them.
+// Not to be called while another thread is scanning.
+bool SelectScoreKernels(ScoreKernels kernels);
+
+}  // namespace SAM
+
+#endif  // SAM_SCORE_KERNELS_H_
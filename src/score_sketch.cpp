@@ -0,0 +1,143 @@
+#include <algorithm>
+#include <cmath>
+
+#include "score_sketch.h"
+
+namespace SAM {
+
+namespace {
+
+// Scores on the edge of a bucket, such as 0.7 with a resolution of 0.1, may
+// be a little less once stored as float; this keeps them in their bucket.
+const double kBucketSlack = 1e-4;
+
+}  // namespace
+
+constexpr double ScoreSketch::kDefaultResolution;
+constexpr double ScoreSketch::kMinResolution;
+constexpr ScoreType ScoreSketch::kTopScore;
+
+ScoreSketch::ScoreSketch(double resolution)
+        : resolution_(resolution >= kMinResolution ?
+                          std::min<double>(resolution, kTopScore) :
+                          kMinResolution),  // NaN as well
+          tree_(static_cast<std::size_t>(kTopScore / resolution_) + 2, 0),
+          size_(0)
+{
+}
+
+void ScoreSketch::Add(ScoreType score)
+{
+    if (score == kInvalidScore || score != score)
+        return;
+
+    AddToBucket(BucketOf(score), 1);
+    size_++;
+}
+
+void ScoreSketch::Remove(ScoreType score)
+{
+    if (score == kInvalidScore || score != score)
+        return;
+
+    // unsigned, so adding the complement takes one away
+    AddToBucket(BucketOf(score), ~std::uint32_t(0));
+    size_--;
+}
+
+void ScoreSketch::Clear()
+{
+    std::fill(tree_.begin(), tree_.end(), 0);
+    size_ = 0;
+}
+
+bool ScoreSketch::Merge(const ScoreSketch &other)
+{
+    if (other.resolution_ != resolution_)
+        return false;
+
+    for (std::size_t index = 0; index < tree_.size(); index++)
+        tree_[index] += other.tree_[index];
+    size_ += other.size_;
+    return true;
+}
+
+std::size_t ScoreSketch::CountAbove(ScoreType score) const
+{
+    return size_ - CountBefore(BucketOf(score) + 1);
+}
+
+int ScoreSketch::Rank(ScoreType score) const
+{
+    if (score == kInvalidScore)
+        return 0;
+    return 1 + static_cast<int>(CountAbove(score));
+}
+
+double ScoreSketch::Percentile(ScoreType score) const
+{
+    if (size_ == 0)
+        return 0;
+    return 100.0 * CountBefore(BucketOf(score)) / size_;
+}
+
+ScoreType ScoreSketch::Quantile(double q) const
+{
+    if (size_ == 0)
+        return kInvalidScore;
+
+    std::size_t rank = 1;
+    double wanted = std::ceil(q * size_);
+    if (wanted > size_)
+        rank = size_;
+    else if (wanted > 1)
+        rank = static_cast<std::size_t>(wanted);
+
+    // Walk down the tree for the last bucket with fewer than rank scores
+    // before it, taking the largest steps first
+    std::size_t bucket_num = tree_.size() - 1;
+    std::size_t step = 1;
+    while (step * 2 <= bucket_num)
+        step *= 2;
+
+    std::size_t position = 0;  // buckets passed
+    std::size_t passed = 0;  // scores in them
+    for (; step != 0; step /= 2)
+    {
+        if (position + step <= bucket_num &&
+            passed + tree_[position + step] < rank)
+        {
+            position += step;
+            passed += tree_[position];
+        }
+    }
+    return static_cast<ScoreType>(position * resolution_);
+}
+
+std::size_t ScoreSketch::BucketOf(ScoreType score) const
+{
+    std::size_t last = tree_.size() - 2;
+    if (!(score > 0))
+        return 0;
+    if (score >= kTopScore)
+        return last;
+    return std::min(last, static_cast<std::size_t>(score / resolution_ +
+                                                   kBucketSlack));
+}
+
+std::size_t ScoreSketch::CountBefore(std::size_t bucket) const
+{
+    std::uint32_t count = 0;
+    for (std::size_t index = bucket; index != 0; index &= index - 1)
+        count += tree_[index];
+    return count;
+}
+
+void ScoreSketch::AddToBucket(std::size_t bucket, std::uint32_t delta)
+{
+    for (std::size_t index = bucket + 1; index < tree_.size();
+         index += index & (~index + 1))
+        tree_[index] += delta;
+}
+
+}  // namespace SAM
@@ -0,0 +1,72 @@
+#ifndef SAM_SCORE_SKETCH_H_
+#define SAM_SCORE_SKETCH_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include <vector>
+
+#include "common.h"
+
+namespace SAM {
+
+// Approximate ranks and quantiles of a set of scores, without a sorted copy.
+// The scores are counted in buckets of resolution() points over [0, 100],
+// the last bucket also taking those above 100 (and the first, those below
+// 0). Adding or removing a score and every query take O(log b) for b
+// buckets, and sketches of the same resolution merge by adding up their
+// counts, so a department or the whole university is the merge of its
+// courses. Invalid scores and NaN are left out.
+//
+// Only scores in different buckets are told apart, so answers are exact
+// except for the scores less than resolution() from the one asked about.
+// With integer scores and a resolution of 1 or less, they are exact.
+class ScoreSketch
+{
+ public:
+    static constexpr double kDefaultResolution = 0.5;
+    // finer ones would take too much memory for a sketch in every course
+    static constexpr double kMinResolution = 0.1;
+    static constexpr ScoreType kTopScore = 100;
+
+    // clamped to [kMinResolution, kTopScore]
+    explicit ScoreSketch(double resolution = kDefaultResolution);
+
+    double resolution() const { return resolution_; }
+    std::size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    void Add(ScoreType score);
+    // score shall have been added
+    void Remove(ScoreType score);
+    void Clear();
+    // Return false (and change nothing) if the resolutions differ
+    bool Merge(const ScoreSketch &other);
+
+    // The number of scores above score, counting none of its bucket
+    std::size_t CountAbove(ScoreType score) const;
+    // 1 + CountAbove(score), 0 for kInvalidScore, as CourseStatistics::Rank
+    int Rank(ScoreType score) const;
+    // Percentage of the scores below score, counting none of its bucket
+    double Percentile(ScoreType score) const;
+    // The lower end of the bucket holding the q-quantile (by nearest rank),
+    // q in [0, 1]: the true one is less than resolution() above it.
+    // kInvalidScore if there is no score.
+    ScoreType Quantile(double q) const;
+
+ private:
+    std::size_t BucketOf(ScoreType score) const;
+    // the number of scores in the buckets before bucket
+    std::size_t CountBefore(std::size_t bucket) const;
+    void AddToBucket(std::size_t bucket, std::uint32_t delta);
+
+    double resolution_;
+    // a Fenwick tree of the counts, by bucket + 1; being a sum of counts,
+    // two of them merge by adding up their entries
+    std::vector<std::uint32_t> tree_;
+    std::size_t size_;
+};
+
+}  // namespace SAM
+
+#endif  // SAM_SCORE_SKETCH_H_
@@ -0,0 +1,211 @@
+#include <cstdio>
+
+#include <fstream>
+#include <sstream>
+#include <utility>
+#include <vector>
+
+#include "atomic_file.h"
+#include "segmented_snapshot.h"
+#include "snapshot.h"
+#include "text_parser.h"
+
+namespace SAM {
+
+namespace {
+
+const char kManifestHeader[] = "SAM-SEGMENTS 1";
+
+// The students and courses of one department, in ID order
+struct Segment
+{
+    std::vector<const Student *> students;
+    std::vector<const Course *> courses;
+};
+
+}  // namespace
+
+SegmentedSnapshot::SegmentedSnapshot(const std::string &manifest_file_name)
+        : manifest_file_name_(manifest_file_name), directory_(), stem_(),
+          generation_(0), log_sequence_(0), segments_(), in_sync_(false),
+          written_num_(0)
+{
+    std::size_t slash = manifest_file_name.rfind('/');
+    std::size_t name_begin = (slash == std::string::npos ? 0 : slash + 1);
+    directory_ = manifest_file_name.substr(0, name_begin);
+    stem_ = manifest_file_name.substr(
+            name_begin, manifest_file_name.find('.', name_begin) - name_begin);
+}
+
+bool SegmentedSnapshot::Read(Manager &manager)
+{
+    if (!ReadManifest())
+        return false;
+
+    std::vector<std::string> file_names;
+    for (const auto &segment : segments_)
+        file_names.push_back(directory_ + segment.second);
+
+    bool was_empty = manager.StudentNumber() == 0 &&
+                     manager.CourseNumber() == 0;
+    SnapshotReader reader;
+    if (!reader.Read(file_names, manager))
+        return false;
+
+    if (was_empty)
+    {
+        manager.ClearDirty();
+        in_sync_ = true;
+    }
+    return true;
+}
+
+bool SegmentedSnapshot::Write(const Manager &manager,
+                              std::uint64_t log_sequence)
+{
+    if (!in_sync_ && !ReadManifest())  // no files yet, or a broken manifest
+    {
+        generation_ = 0;
+        segments_.clear();
+    }
+
+    // the departments to write: dirty ones, and those without a segment
+    const std::set<int> &dirty = manager.dirty_departments();
+    auto to_write = [this, &dirty](int department)
+    {
+        return !in_sync_ || dirty.count(department) != 0 ||
+               segments_.count(department) == 0;
+    };
+
+    std::map<int, Segment> parts;
+    for (auto iter = manager.student_begin();
+         iter != manager.student_end();
+         ++iter)
+    {
+        if (to_write(iter->info().department))
+            parts[iter->info().department].students.push_back(&*iter);
+    }
+    for (auto iter = manager.course_begin();
+         iter != manager.course_end();
+         ++iter)
+    {
+        if (to_write(iter->info().department))
+            parts[iter->info().department].courses.push_back(&*iter);
+    }
+
+    // Segments of departments left alone stay, those of dirty departments
+    // without students or courses any more go.
+    std::map<int, std::string> segments;
+    if (in_sync_)
+    {
+        segments = segments_;
+        for (int department : dirty)
+            segments.erase(department);
+    }
+
+    std::uint64_t generation = generation_ + 1;
+    SnapshotWriter writer;
+    for (const auto &part : parts)
+    {
+        std::string file_name = SegmentFileName(part.first, generation);
+        if (!writer.Write(directory_ + file_name, part.second.students,
+                          part.second.courses, log_sequence))
+            return false;
+        segments[part.first] = file_name;
+    }
+
+    std::string manifest(kManifestHeader);
+    manifest += "\ngeneration ";
+    AppendUInt(manifest, generation);
+    manifest += "\nlog ";
+    AppendUInt(manifest, log_sequence);
+    manifest += '\n';
+    for (const auto &segment : segments)
+    {
+        manifest += "segment ";
+        AppendInt(manifest, segment.first);
+        manifest += ' ';
+        manifest += segment.second;
+        manifest += '\n';
+    }
+
+    AtomicFile fout;
+    if (!fout.Open(manifest_file_name_))
+        return false;
+    fout.Append(manifest.data(), manifest.size());
+    if (!fout.Commit())
+        return false;
+
+    // the old manifest is gone, so are the files only it listed
+    for (const auto &segment : segments_)
+    {
+        auto iter = segments.find(segment.first);
+        if (iter == segments.end() || iter->second != segment.second)
+            std::remove((directory_ + segment.second).c_str());
+    }
+
+    segments_.swap(segments);
+    generation_ = generation;
+    log_sequence_ = log_sequence;
+    in_sync_ = true;
+    written_num_ = parts.size();
+    return true;
+}
+
+bool SegmentedSnapshot::ReadManifest()
+{
+    std::ifstream fin(manifest_file_name_, std::ios::binary);
+    if (!fin.is_open())
+        return false;
+
+    std::ostringstream oss;
+    oss << fin.rdbuf();
+    std::string text = oss.str();
+
+    TextParser parser(text);
+    TextSpan field;
+    std::uint64_t generation, log_sequence;
+    if (!parser.NextLine() || !parser.NextField(field) ||
+        field.str() != "SAM-SEGMENTS" || !parser.NextField(field) ||
+        field.str() != "1" ||
+        !parser.NextLine() || !parser.NextField(field) ||
+        field.str() != "generation" ||
+        !parser.ReadUInt64("generation", generation) ||
+        !parser.NextLine() || !parser.NextField(field) ||
+        field.str() != "log" ||
+        !parser.ReadUInt64("log sequence", log_sequence))
+        return false;
+
+    std::map<int, std::string> segments;
+    while (parser.NextNonBlankLine())
+    {
+        int department;
+        std::string file_name;
+        if (!parser.NextField(field) || field.str() != "segment" ||
+            !parser.ReadInt("department", department) ||
+            !parser.ReadString("file name", file_name) ||
+            !parser.ExpectLineEnd())
+            return false;
+
+        segments[department] = file_name;
+    }
+
+    generation_ = generation;
+    log_sequence_ = log_sequence;
+    segments_.swap(segments);
+    return true;
+}
+
+std::string SegmentedSnapshot::SegmentFileName(int department,
+                                               std::uint64_t generation) const
+{
+    std::string file_name(stem_);
+    file_name += '-';
+    AppendInt(file_name, department);
+    file_name += '-';
+    AppendUInt(file_name, generation);
+    file_name += ".seg";
+    return file_name;
+}
+
+}  // namespace SAM
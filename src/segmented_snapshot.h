@@ -0,0 +1,72 @@
+#ifndef SAM_SEGMENTED_SNAPSHOT_H_
+#define SAM_SEGMENTED_SNAPSHOT_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include <map>
+#include <string>
+
+#include "manager.h"
+
+namespace SAM {
+
+// The data of a Manager split into one snapshot per department (a segment
+// holds the students and courses of that department, rosters included),
+// listed by a text manifest:
+//
+//     SAM-SEGMENTS 1
+//     generation <number>
+//     log <sequence>
+//     segment <department> <file name>
+//     ...
+//
+// Segment files live next to the manifest and are never overwritten: a
+// write puts the dirty departments into new files named after the next
+// generation, replaces the manifest atomically, and only then removes the
+// files it no longer lists. A crash at any point leaves the old manifest
+// with all of its segments.
+class SegmentedSnapshot
+{
+ public:
+    explicit SegmentedSnapshot(const std::string &manifest_file_name);
+
+    // Read every segment. Return false (and change nothing) if there is no
+    // valid manifest or any segment cannot be read. If manager was empty,
+    // it is in sync with the files afterwards and its dirty marks cleared.
+    bool Read(Manager &manager);
+
+    // Once in sync, write only the departments manager marks dirty (its
+    // marks are left to the caller), otherwise all of them.
+    bool Write(const Manager &manager, std::uint64_t log_sequence);
+
+    // whether the files hold the manager as of its last ClearDirty()
+    bool in_sync() const { return in_sync_; }
+    // Forget the manager the files were in sync with, such as before it is
+    // cleared and loaded again: the next Write() writes every department
+    void Reset() { in_sync_ = false; }
+    // the last log group the files contain
+    std::uint64_t log_sequence() const { return log_sequence_; }
+    std::size_t segment_num() const { return segments_.size(); }
+    // by the last Write()
+    std::size_t written_num() const { return written_num_; }
+
+ private:
+    bool ReadManifest();
+    std::string SegmentFileName(int department,
+                                std::uint64_t generation) const;
+
+    std::string manifest_file_name_;
+    std::string directory_;  // of the manifest, with the trailing '/'
+    std::string stem_;       // its name up to the first '.'
+
+    std::uint64_t generation_;
+    std::uint64_t log_sequence_;
+    std::map<int, std::string> segments_;  // department -> file name
+    bool in_sync_;
+    std::size_t written_num_;
+};
+
+}  // namespace SAM
+
+#endif  // SAM_SEGMENTED_SNAPSHOT_H_
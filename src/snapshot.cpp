@@ -0,0 +1,488 @@
+#include <cstring>
+
+#include <algorithm>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#if !defined(_WIN32) && (defined(__unix__) || defined(__unix) || (defined(__APPLE__) && defined(__MACH__)))
+
+#ifndef UNIX_LIKE_SYS
+#define UNIX_LIKE_SYS
+#endif
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#endif
+
+#include "atomic_file.h"
+#include "roster_codec.h"
+#include "snapshot.h"
+
+namespace SAM {
+
+static_assert(sizeof(SnapshotHeader) == 120, "unexpected header layout");
+static_assert(sizeof(SnapshotStudent) == 24, "unexpected student layout");
+static_assert(sizeof(SnapshotCourse) == 56, "unexpected course layout");
+static_assert(sizeof(ScoreType) == 4 &&
+              std::numeric_limits<ScoreType>::is_iec559,
+              "scores are stored as IEEE single precision");
+
+namespace {
+
+// where the header of each older version ends
+const std::size_t kVersion1HeaderSize = 96;
+const std::size_t kVersion2HeaderSize = 104;
+
+std::uint64_t AlignUp(std::uint64_t offset)
+{
+    return (offset + 7) & ~std::uint64_t(7);
+}
+
+bool IsLittleEndian()
+{
+    std::uint32_t probe = 1;
+    unsigned char first;
+    std::memcpy(&first, &probe, 1);
+    return first == 1;
+}
+
+// Lay out the string pool, sharing equal strings
+class StringPool
+{
+ public:
+    SnapshotString Add(const std::string &str)
+    {
+        auto iter = offsets_.find(str);
+        if (iter != offsets_.end())
+            return iter->second;
+
+        SnapshotString ref{static_cast<std::uint32_t>(data_.size()),
+                           static_cast<std::uint32_t>(str.size())};
+        data_ += str;
+        offsets_.emplace(str, ref);
+        return ref;
+    }
+
+    const std::string & data() const { return data_; }
+
+ private:
+    std::string data_;
+    std::unordered_map<std::string, SnapshotString> offsets_;
+};
+
+}  // namespace
+
+SnapshotFile::SnapshotFile() : data_(nullptr), size_(0), mapped_(false),
+                               buffer_()
+{
+}
+
+SnapshotFile::~SnapshotFile()
+{
+    Close();
+}
+
+bool SnapshotFile::Open(const std::string &file_name)
+{
+    Close();
+
+#ifdef UNIX_LIKE_SYS
+    int fd = ::open(file_name.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat file_stat;
+    if (::fstat(fd, &file_stat) == 0 && file_stat.st_size > 0)
+    {
+        void *data = ::mmap(nullptr, file_stat.st_size, PROT_READ,
+                            MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED)
+        {
+            data_ = static_cast<const char *>(data);
+            size_ = file_stat.st_size;
+            mapped_ = true;
+        }
+    }
+    ::close(fd);
+
+    if (!mapped_)
+        return false;
+#else
+    std::ifstream fin(file_name, std::ios::binary | std::ios::ate);
+    if (!fin.is_open())
+        return false;
+
+    size_ = fin.tellg();
+    buffer_.resize((size_ + 7) / 8);
+    fin.seekg(0);
+    if (!fin.read(reinterpret_cast<char *>(buffer_.data()), size_))
+    {
+        Close();
+        return false;
+    }
+    data_ = reinterpret_cast<const char *>(buffer_.data());
+#endif
+
+    if (!Validate())
+    {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+void SnapshotFile::Close()
+{
+#ifdef UNIX_LIKE_SYS
+    if (mapped_)
+        ::munmap(const_cast<char *>(data_), size_);
+#endif
+
+    data_ = nullptr;
+    size_ = 0;
+    mapped_ = false;
+    buffer_.clear();
+}
+
+std::size_t SnapshotFile::HeaderSize() const
+{
+    switch (header().version)
+    {
+        case 1:
+            return kVersion1HeaderSize;
+        case 2:
+            return kVersion2HeaderSize;
+        default:
+            return sizeof(SnapshotHeader);
+    }
+}
+
+bool SnapshotFile::Validate() const
+{
+    if (!IsLittleEndian() || size_ < kVersion1HeaderSize)
+        return false;
+
+    const SnapshotHeader &head = header();
+    if (std::memcmp(head.magic, kSnapshotMagic, sizeof(kSnapshotMagic)) != 0 ||
+        head.version < 1 || head.version > kSnapshotVersion ||
+        size_ < HeaderSize() ||
+        head.byte_order != kSnapshotByteOrder ||
+        head.file_size != size_)
+        return false;
+
+    // every section shall be aligned, in bounds, and large enough
+    struct Section
+    {
+        std::uint64_t offset;
+        std::uint64_t count;
+        std::uint64_t item_size;
+    };
+    bool packed = head.version >= 3;
+    std::vector<Section> sections = {
+        {head.students_offset, head.student_num, sizeof(SnapshotStudent)},
+        {head.courses_offset, head.course_num, sizeof(SnapshotCourse)},
+        {head.string_pool_offset, head.string_pool_size, 1}
+    };
+    if (packed)
+    {
+        sections.push_back(Section{head.rosters_offset, head.rosters_size, 1});
+    }
+    else
+    {
+        sections.push_back(Section{head.roster_ids_offset, head.enrollment_num,
+                                   sizeof(std::uint64_t)});
+        sections.push_back(Section{head.roster_scores_offset,
+                                   head.enrollment_num, sizeof(float)});
+    }
+    for (const Section &section : sections)
+    {
+        if (section.offset % 8 != 0 || section.offset < HeaderSize() ||
+            section.offset > size_ ||
+            section.count > (size_ - section.offset) / section.item_size)
+            return false;
+    }
+
+    auto string_ok = [&head](SnapshotString str)
+    {
+        return str.offset <= head.string_pool_size &&
+               str.size <= head.string_pool_size - str.offset;
+    };
+
+    const SnapshotStudent *student_table = students();
+    for (std::uint64_t index = 0; index < head.student_num; index++)
+    {
+        const SnapshotStudent &student = student_table[index];
+        if (!string_ok(student.name) ||
+            (index != 0 && student.id <= student_table[index - 1].id))
+            return false;
+    }
+
+    const SnapshotCourse *course_table = courses();
+    for (std::uint64_t index = 0; index < head.course_num; index++)
+    {
+        const SnapshotCourse &course = course_table[index];
+        if (!string_ok(course.id) || !string_ok(course.name) ||
+            !string_ok(course.teacher_name))
+            return false;
+
+        if (packed)
+        {
+            // the rest is checked by UnpackRoster(), but an entry takes at
+            // least 2 bytes, so a broken size cannot ask for much memory
+            if (course.roster_begin > head.rosters_size ||
+                course.roster_size >
+                    (head.rosters_size - course.roster_begin) / 2)
+                return false;
+            continue;
+        }
+
+        if (course.roster_begin > head.enrollment_num ||
+            course.roster_size > head.enrollment_num - course.roster_begin)
+            return false;
+
+        const std::uint64_t *ids = reinterpret_cast<const std::uint64_t *>(
+                data_ + head.roster_ids_offset);
+        for (std::uint64_t pos = 1; pos < course.roster_size; pos++)
+        {
+            if (ids[course.roster_begin + pos] <=
+                ids[course.roster_begin + pos - 1])
+                return false;
+        }
+    }
+
+    return true;
+}
+
+bool SnapshotFile::ReadRoster(std::uint64_t index, FinalScore &roster) const
+{
+    const SnapshotHeader &head = header();
+    const SnapshotCourse &course = courses()[index];
+
+    if (head.version >= 3)
+    {
+        const char *rosters = data_ + head.rosters_offset;
+        return UnpackRoster(rosters + course.roster_begin,
+                            rosters + head.rosters_size,
+                            course.roster_size, roster) != nullptr;
+    }
+
+    const std::uint64_t *ids = Section<std::uint64_t>(head.roster_ids_offset);
+    const float *scores = Section<float>(head.roster_scores_offset);
+    roster.reserve(roster.size() + course.roster_size);
+    for (std::uint64_t pos = course.roster_begin;
+         pos < course.roster_begin + course.roster_size; pos++)
+        roster.push_back(ScorePiece{ids[pos], scores[pos]});
+    return true;
+}
+
+SnapshotReader::SnapshotReader() : log_sequence_(0)
+{
+}
+
+bool SnapshotReader::Read(const std::string &file_name, Manager &manager)
+{
+    return Read(std::vector<std::string>{file_name}, manager);
+}
+
+bool SnapshotReader::Read(const std::vector<std::string> &file_names,
+                          Manager &manager)
+{
+    std::vector<std::unique_ptr<SnapshotFile>> snapshots;
+    std::uint64_t student_num = 0, course_num = 0;
+    for (const std::string &file_name : file_names)
+    {
+        snapshots.emplace_back(new SnapshotFile());
+        if (!snapshots.back()->Open(file_name))
+            return false;
+
+        student_num += snapshots.back()->header().student_num;
+        course_num += snapshots.back()->header().course_num;
+    }
+
+    // packed rosters are checked as they are unpacked, so before anything
+    // is added
+    std::vector<std::vector<FinalScore>> file_rosters(snapshots.size());
+    for (std::size_t file = 0; file < snapshots.size(); file++)
+    {
+        const SnapshotFile &snapshot = *snapshots[file];
+        file_rosters[file].resize(snapshot.header().course_num);
+        for (std::uint64_t index = 0;
+             index < snapshot.header().course_num;
+             index++)
+        {
+            if (!snapshot.ReadRoster(index, file_rosters[file][index]))
+                return false;
+        }
+    }
+
+    log_sequence_ = 0;
+    for (const auto &snapshot : snapshots)
+        log_sequence_ = std::max(log_sequence_, snapshot->log_sequence());
+
+    manager.Reserve(manager.StudentNumber() + student_num,
+                    manager.CourseNumber() + course_num);
+
+    // every student first, rosters of one file may name those of another
+    for (const auto &snapshot : snapshots)
+    {
+        const SnapshotHeader &head = snapshot->header();
+        const SnapshotStudent *students = snapshot->students();
+        for (std::uint64_t index = 0; index < head.student_num; index++)
+        {
+            const SnapshotStudent &student = students[index];
+            manager.AddStudent(StudentInfo{student.id,
+                                           snapshot->String(student.name),
+                                           student.is_male != 0,
+                                           student.department});
+        }
+    }
+
+    std::vector<Manager::SavedRoster> rosters;
+    rosters.reserve(course_num);
+    for (std::size_t file = 0; file < snapshots.size(); file++)
+    {
+        const auto &snapshot = snapshots[file];
+        const SnapshotHeader &head = snapshot->header();
+        const SnapshotCourse *courses = snapshot->courses();
+        for (std::uint64_t index = 0; index < head.course_num; index++)
+        {
+            const SnapshotCourse &course = courses[index];
+            CourseInfo info{snapshot->String(course.id),
+                            snapshot->String(course.name),
+                            course.department,
+                            course.credit,
+                            static_cast<std::size_t>(course.capacity),
+                            snapshot->String(course.teacher_name)};
+            if (!manager.AddCourse(info))  // the first one wins
+                continue;
+
+            rosters.emplace_back(manager.FindCourseHandle(info.id),
+                                 std::move(file_rosters[file][index]));
+        }
+    }
+
+    RosterLoadSummary summary;
+    manager.LoadRosters(rosters, false, summary);
+    return true;
+}
+
+bool SnapshotWriter::Write(const std::string &file_name,
+                           const Manager &manager,
+                           std::uint64_t log_sequence)
+{
+    std::vector<const Student *> students;
+    std::vector<const Course *> courses;
+    students.reserve(manager.StudentNumber());
+    courses.reserve(manager.CourseNumber());
+    for (auto iter = manager.student_begin();
+         iter != manager.student_end();
+         ++iter)
+        students.push_back(&*iter);
+    for (auto iter = manager.course_begin();
+         iter != manager.course_end();
+         ++iter)
+        courses.push_back(&*iter);
+
+    return Write(file_name, students, courses, log_sequence);
+}
+
+bool SnapshotWriter::Write(const std::string &file_name,
+                           const std::vector<const Student *> &student_list,
+                           const std::vector<const Course *> &course_list,
+                           std::uint64_t log_sequence)
+{
+    if (!IsLittleEndian())
+        return false;
+
+    StringPool pool;
+
+    std::vector<SnapshotStudent> students;
+    students.reserve(student_list.size());
+    for (const Student *student : student_list)
+    {
+        const StudentInfo &info = student->info();
+        students.push_back(SnapshotStudent{info.id, pool.Add(info.name),
+                                           info.department,
+                                           info.is_male ? 1u : 0u});
+    }
+
+    std::vector<SnapshotCourse> courses;
+    std::string rosters;
+    std::uint64_t enrollment_num = 0;
+    courses.reserve(course_list.size());
+    for (const Course *course : course_list)
+    {
+        const CourseInfo &info = course->info();
+        RosterView roster = course->final_score();
+        courses.push_back(SnapshotCourse{pool.Add(info.id),
+                                         pool.Add(info.name),
+                                         pool.Add(info.teacher_name),
+                                         info.department,
+                                         info.credit,
+                                         info.capacity,
+                                         rosters.size(),
+                                         roster.size()});
+
+        PackRoster(roster.ids(), roster.scores(), roster.size(), rosters);
+        enrollment_num += roster.size();
+    }
+
+    if (pool.data().size() > std::numeric_limits<std::uint32_t>::max())
+        return false;
+
+    SnapshotHeader head;
+    std::memset(&head, 0, sizeof(head));
+    std::memcpy(head.magic, kSnapshotMagic, sizeof(kSnapshotMagic));
+    head.version = kSnapshotVersion;
+    head.byte_order = kSnapshotByteOrder;
+    head.student_num = students.size();
+    head.course_num = courses.size();
+    head.enrollment_num = enrollment_num;
+    head.string_pool_size = pool.data().size();
+    head.log_sequence = log_sequence;
+
+    head.students_offset = sizeof(head);
+    head.courses_offset = AlignUp(head.students_offset +
+                                  students.size() * sizeof(SnapshotStudent));
+    head.rosters_offset = AlignUp(head.courses_offset +
+                                  courses.size() * sizeof(SnapshotCourse));
+    head.rosters_size = rosters.size();
+    head.string_pool_offset = AlignUp(head.rosters_offset + rosters.size());
+    head.file_size = head.string_pool_offset + pool.data().size();
+
+    AtomicFile fout;
+    if (!fout.Open(file_name))
+        return false;
+
+    static const char kPadding[8] = {};
+    std::uint64_t position = 0;
+    auto write_section = [&fout, &position](std::uint64_t offset,
+                                            const void *data,
+                                            std::uint64_t size)
+    {
+        fout.Append(kPadding, offset - position);
+        fout.Append(static_cast<const char *>(data), size);
+        fout.MaybeFlush();
+        position = offset + size;
+    };
+
+    write_section(0, &head, sizeof(head));
+    write_section(head.students_offset, students.data(),
+                  students.size() * sizeof(SnapshotStudent));
+    write_section(head.courses_offset, courses.data(),
+                  courses.size() * sizeof(SnapshotCourse));
+    write_section(head.rosters_offset, rosters.data(), rosters.size());
+    write_section(head.string_pool_offset, pool.data().data(),
+                  pool.data().size());
+
+    return fout.Commit();
+}
+
+}  // namespace SAM
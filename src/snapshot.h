@@ -0,0 +1,180 @@
+#ifndef SAM_SNAPSHOT_H_
+#define SAM_SNAPSHOT_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include <string>
+#include <vector>
+
+#include "manager.h"
+
+namespace SAM {
+
+// Binary snapshot of a Manager, laid out so that it can be mapped into
+// memory and its tables used in place. All integers are little-endian, every section
+// starts at a multiple of 8 bytes:
+//
+//     SnapshotHeader
+//     SnapshotStudent[student_num]    sorted by ID
+//     SnapshotCourse[course_num]      sorted by ID
+//     char rosters[rosters_size]
+//     char string_pool[string_pool_size]
+//
+// The roster of a course, roster_size entries sorted by student ID, is
+// packed by PackRoster() at rosters + roster_begin. Strings are (offset,
+// size) into the pool, which is not null-terminated and shares equal
+// strings.
+//
+// Older versions are still read. Version 3 has packed the rosters, which
+// took 12 bytes an entry before, with roster_begin an index into
+//
+//     uint64 roster_ids[enrollment_num]
+//     float roster_scores[enrollment_num]
+//
+// in place of the rosters section. Version 2 has added log_sequence to the
+// header, the header of each version ends before the fields added later.
+
+const char kSnapshotMagic[8] = {'S', 'A', 'M', 'S', 'N', 'A', 'P', '\0'};
+const std::uint32_t kSnapshotVersion = 3;
+const std::uint32_t kSnapshotByteOrder = 0x01020304u;
+
+struct SnapshotString
+{
+    std::uint32_t offset;
+    std::uint32_t size;
+};
+
+struct SnapshotHeader
+{
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t byte_order;  // kSnapshotByteOrder as written
+
+    std::uint64_t student_num;
+    std::uint64_t course_num;
+    std::uint64_t enrollment_num;
+    std::uint64_t string_pool_size;
+
+    // byte offsets from the beginning of the file
+    std::uint64_t students_offset;
+    std::uint64_t courses_offset;
+    std::uint64_t roster_ids_offset;     // before version 3, 0 since
+    std::uint64_t roster_scores_offset;  // before version 3, 0 since
+    std::uint64_t string_pool_offset;
+    std::uint64_t file_size;
+
+    // the last MutationLog group folded into this snapshot (version 2)
+    std::uint64_t log_sequence;
+
+    // version 3
+    std::uint64_t rosters_offset;
+    std::uint64_t rosters_size;
+};
+
+struct SnapshotStudent
+{
+    std::uint64_t id;
+    SnapshotString name;
+    std::int32_t department;
+    std::uint32_t is_male;
+};
+
+struct SnapshotCourse
+{
+    SnapshotString id;
+    SnapshotString name;
+    SnapshotString teacher_name;
+    std::int32_t department;
+    std::int32_t credit;
+    std::uint64_t capacity;
+    std::uint64_t roster_begin;
+    std::uint64_t roster_size;
+};
+
+// A snapshot file mapped into memory (or read into a buffer where mmap is
+// not available). Open() checks the whole layout, so afterwards every
+// table and string can be used without further checks.
+class SnapshotFile
+{
+ public:
+    SnapshotFile();
+    ~SnapshotFile();
+    SnapshotFile(const SnapshotFile &) = delete;
+    SnapshotFile & operator=(const SnapshotFile &) = delete;
+
+    // Return false if the file cannot be read or is not a valid snapshot
+    bool Open(const std::string &file_name);
+    void Close();
+
+    // Fields after file_size are only there in newer versions,
+    // use the accessors below for them.
+    const SnapshotHeader & header() const
+    { return *reinterpret_cast<const SnapshotHeader *>(data_); }
+    std::uint64_t log_sequence() const
+    { return header().version >= 2 ? header().log_sequence : 0; }
+
+    const SnapshotStudent * students() const
+    { return Section<SnapshotStudent>(header().students_offset); }
+    const SnapshotCourse * courses() const
+    { return Section<SnapshotCourse>(header().courses_offset); }
+
+    // Append the roster of courses()[index] to roster. Return false if it
+    // is broken: packed rosters are only checked when unpacked.
+    bool ReadRoster(std::uint64_t index, FinalScore &roster) const;
+
+    std::string String(SnapshotString str) const
+    {
+        return std::string(data_ + header().string_pool_offset + str.offset,
+                           str.size);
+    }
+
+ private:
+    template <typename T>
+    const T * Section(std::uint64_t offset) const
+    { return reinterpret_cast<const T *>(data_ + offset); }
+
+    std::size_t HeaderSize() const;
+    bool Validate() const;
+
+    const char *data_;
+    std::size_t size_;
+    bool mapped_;
+    std::vector<std::uint64_t> buffer_;  // keeps the data 8-byte aligned
+};
+
+class SnapshotReader
+{
+ public:
+    SnapshotReader();
+
+    // Students and courses already in manager are kept, as ManagerReader
+    // does. Nothing is changed if the file is not a valid snapshot.
+    bool Read(const std::string &file_name, Manager &manager);
+    // Read several snapshots as one, nothing is changed unless every one
+    // of them is valid
+    bool Read(const std::vector<std::string> &file_names, Manager &manager);
+
+    // the largest of the snapshots last read, 0 if they have none
+    std::uint64_t log_sequence() const { return log_sequence_; }
+
+ private:
+    std::uint64_t log_sequence_;
+};
+
+class SnapshotWriter
+{
+ public:
+    // log_sequence: the last log group that manager contains
+    bool Write(const std::string &file_name, const Manager &manager,
+               std::uint64_t log_sequence = 0);
+    // Write only some of the students and courses, each list in ID order
+    bool Write(const std::string &file_name,
+               const std::vector<const Student *> &students,
+               const std::vector<const Course *> &courses,
+               std::uint64_t log_sequence = 0);
+};
+
+}  // namespace SAM
+
+#endif  // SAM_SNAPSHOT_H_
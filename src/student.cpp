@@ -1,42 +1,26 @@
-#include <algorithm>
 #include <iomanip>
 #include "student.h"
 
 namespace SAM {
 
-Student::Student(const StudentInfo& info)
+Student::Student(const StudentInfo& info,
+                 StudentHandle handle,
+                 const EnrollmentIndex *enrollment)
         : info_(info),
-          courses_taken_()
+          handle_(handle),
+          enrollment_(enrollment)
 {
 }
 
-void Student::AddCourse(const CourseInfo::IDType &course_id)
+ScoreType Student::gpa() const
 {
-    courses_taken_.push_back(course_id);
-    auto range_pair = std::equal_range(courses_taken_.begin(),
-                                       courses_taken_.end(),
-                                       course_id);
-    if (range_pair.first == range_pair.second)  // a new course to take
-        courses_taken_.insert(range_pair.first, course_id);
-    // else this course already taken, do nothing
-}
-
-void Student::RemoveCourse(const CourseInfo::IDType &course_id)
-{
-    auto range_pair = std::equal_range(courses_taken_.begin(),
-                                       courses_taken_.end(),
-                                       course_id);
-    if (range_pair.first == range_pair.second)  // has not taken this course
-        return;
+    if (!enrollment_)
+        return kInvalidScore;
 
-    courses_taken_.erase(range_pair.first);
-}
-
-bool Student::InCourse(const CourseInfo::IDType &course_id) const
-{
-    return std::binary_search(courses_taken_.begin(),
-                              courses_taken_.end(),
-                              course_id);
+    EnrollmentIndex::CreditTotal total = enrollment_->CreditsOf(handle_);
+    if (total.credit == 0)
+        return kInvalidScore;
+    return static_cast<ScoreType>(total.weighted_sum / total.credit);
 }
 
 std::string Student::Heading()
@@ -6,27 +6,40 @@
 #include <vector>
 
 #include "common.h"
+#include "enrollment.h"
 
 namespace SAM {
 
-// Store the basic information of a student, and manage the course he/she takes.
+// Store the basic information of a student.
+// The courses he/she takes are kept by the EnrollmentIndex of the Manager.
 // Every student shall has a UNIQUE id.
 class Student
 {
  public:
     typedef StudentInfo::IDType IDType;
 
-    Student() = default;
-    explicit Student(const StudentInfo& info);
+    Student() : info_(), handle_(kNoStudent), enrollment_(nullptr) {}
+    explicit Student(const StudentInfo& info,
+                     StudentHandle handle = kNoStudent,
+                     const EnrollmentIndex *enrollment = nullptr);
 
-    void AddCourse(const CourseInfo::IDType &course_id);
-    void RemoveCourse(const CourseInfo::IDType &course_id);
-    bool InCourse(const CourseInfo::IDType &course_id) const;
+    bool InCourse(CourseHandle course) const
+    { return courses_taken().Contains(course); }
 
     // accessors
     const StudentInfo & info() const { return info_; }
-    const std::vector<CourseInfo::IDType> & courses_taken() const
-    { return courses_taken_; }
+    StudentHandle handle() const { return handle_; }
+    // Sorted by handle, see Manager::SortByCourseID for display order
+    CourseList courses_taken() const
+    {
+        return enrollment_ ? enrollment_->CoursesOf(handle_) : CourseList();
+    }
+    // Of the courses with a valid score, kept by the Manager, so the courses
+    // are not visited
+    int total_credit() const
+    { return enrollment_ ? enrollment_->CreditsOf(handle_).credit : 0; }
+    // kInvalidScore if there is no credit
+    ScoreType gpa() const;
 
     // mutators
     // ID is ought to be unique, so remember to check whether there is
@@ -51,7 +64,8 @@ class Student
 
  private:
     StudentInfo info_;
-    std::vector<CourseInfo::IDType> courses_taken_;  // always sorted
+    StudentHandle handle_;
+    const EnrollmentIndex *enrollment_;
 };
 
 std::ostream & operator<<(std::ostream &os, const Student &student);
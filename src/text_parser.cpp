@@ -0,0 +1,404 @@
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <limits>
+
+#include "text_parser.h"
+
+namespace SAM {
+
+namespace {
+
+bool IsBlank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+bool IsDigit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+// Powers of ten that are exact in a float
+const float kExactPowersOfTen[] = {
+    1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f
+};
+
+}  // namespace
+
+bool ParseUInt64(TextSpan text, std::uint64_t &value)
+{
+    if (text.empty())
+        return false;
+
+    const std::uint64_t kMax = std::numeric_limits<std::uint64_t>::max();
+    std::uint64_t result = 0;
+    for (const char *p = text.begin; p != text.end; ++p)
+    {
+        if (!IsDigit(*p))
+            return false;
+
+        unsigned digit = *p - '0';
+        if (result > (kMax - digit) / 10)  // overflow
+            return false;
+        result = result * 10 + digit;
+    }
+
+    value = result;
+    return true;
+}
+
+bool ParseInt(TextSpan text, int &value)
+{
+    bool negative = !text.empty() && *text.begin == '-';
+    if (!text.empty() && (*text.begin == '-' || *text.begin == '+'))
+        text.begin++;
+
+    std::uint64_t magnitude;
+    if (!ParseUInt64(text, magnitude))
+        return false;
+
+    const std::uint64_t kLimit =
+            static_cast<std::uint64_t>(std::numeric_limits<int>::max()) +
+            (negative ? 1 : 0);
+    if (magnitude > kLimit)
+        return false;
+
+    value = negative ? static_cast<int>(-static_cast<std::int64_t>(magnitude))
+                     : static_cast<int>(magnitude);
+    return true;
+}
+
+bool ParseScore(TextSpan text, ScoreType &value)
+{
+    // sign, digits, optional fraction, optional exponent
+    const char *p = text.begin;
+    bool negative = false;
+    if (p != text.end && (*p == '-' || *p == '+'))
+        negative = (*p++ == '-');
+
+    std::uint64_t mantissa = 0;
+    int digit_num = 0;      // significant digits in mantissa
+    int scale = 0;          // value = mantissa * 10^scale
+    bool has_digits = false;
+    bool exact = true;      // mantissa holds every digit
+
+    for (; p != text.end && IsDigit(*p); ++p)
+    {
+        has_digits = true;
+        if (digit_num < 19)
+        {
+            mantissa = mantissa * 10 + (*p - '0');
+            if (mantissa != 0)
+                digit_num++;
+        }
+        else
+        {
+            scale++;
+            exact = false;
+        }
+    }
+    if (p != text.end && *p == '.')
+    {
+        for (++p; p != text.end && IsDigit(*p); ++p)
+        {
+            has_digits = true;
+            if (digit_num < 19)
+            {
+                mantissa = mantissa * 10 + (*p - '0');
+                if (mantissa != 0)
+                    digit_num++;
+                scale--;
+            }
+            else
+            {
+                exact = false;
+            }
+        }
+    }
+    if (!has_digits)
+        return false;
+
+    if (p != text.end && (*p == 'e' || *p == 'E'))
+    {
+        ++p;
+        int exponent;
+        const char *exponent_begin = p;
+        if (p != text.end && (*p == '-' || *p == '+'))
+            ++p;
+        while (p != text.end && IsDigit(*p))
+            ++p;
+        if (!ParseInt(TextSpan{exponent_begin, p}, exponent) ||
+            exponent > 10000 || exponent < -10000)
+            return false;
+        scale += exponent;
+    }
+    if (p != text.end)
+        return false;
+
+    // Both operands are exact floats, so one IEEE operation rounds correctly.
+    if (exact && mantissa < (1u << 24) && scale >= -10 && scale <= 10)
+    {
+        float result = static_cast<float>(mantissa);
+        if (scale < 0)
+            result /= kExactPowersOfTen[-scale];
+        else
+            result *= kExactPowersOfTen[scale];
+        value = negative ? -result : result;
+        return true;
+    }
+
+    // rare: let the C library do it (the C locale is never changed here)
+    char buffer[128];
+    if (text.size() >= sizeof(buffer))
+        return false;
+    std::memcpy(buffer, text.begin, text.size());
+    buffer[text.size()] = '\0';
+    errno = 0;
+    value = std::strtof(buffer, nullptr);
+    // out of range, as istream >> float would reject it: inf could be
+    // written but never read back
+    return errno != ERANGE && std::isfinite(value);
+}
+
+void AppendUInt(std::string &out, std::uint64_t value)
+{
+    char digits[20];
+    int size = 0;
+    do
+    {
+        digits[size++] = static_cast<char>('0' + value % 10);
+        value /= 10;
+    } while (value != 0);
+
+    while (size > 0)
+        out += digits[--size];
+}
+
+void AppendInt(std::string &out, long long value)
+{
+    if (value < 0)
+    {
+        out += '-';
+        AppendUInt(out, 0 - static_cast<std::uint64_t>(value));
+    }
+    else
+    {
+        AppendUInt(out, static_cast<std::uint64_t>(value));
+    }
+}
+
+void AppendScore(std::string &out, ScoreType score, int precision)
+{
+    // Most scores are whole numbers, which %g prints as plain integers
+    // below a million (precision is never less than 6)
+    if (score > -1e6f && score < 1e6f)
+    {
+        int whole = static_cast<int>(score);
+        if (static_cast<ScoreType>(whole) == score)
+        {
+            if (whole == 0 && std::signbit(score))
+                out += '-';  // -0
+            AppendInt(out, whole);
+            return;
+        }
+    }
+
+    char text[48];
+    int size = std::snprintf(text, sizeof(text), "%.*g", precision, score);
+    out.append(text, size);
+}
+
+void AppendStudentInfo(std::string &out, const StudentInfo &info)
+{
+    AppendUInt(out, info.id);
+    out += ' ';
+    out += info.name;
+    out += (info.is_male ? " 1 " : " 0 ");
+    AppendInt(out, info.department);
+}
+
+void AppendCourseInfo(std::string &out, const CourseInfo &info)
+{
+    out += info.id;
+    out += ' ';
+    out += info.name;
+    out += ' ';
+    AppendInt(out, info.department);
+    out += ' ';
+    AppendInt(out, info.credit);
+    out += ' ';
+    AppendUInt(out, info.capacity);
+    out += ' ';
+    out += info.teacher_name;
+}
+
+std::string ParseError::ToString() const
+{
+    return "line " + std::to_string(line) + ", column " +
+           std::to_string(column) + ": expected " + field;
+}
+
+TextParser::TextParser(const char *begin, const char *end)
+        : next_line_(begin), end_(end), line_begin_(begin), line_end_(begin),
+          position_(begin), line_number_(0), error_{0, 0, std::string()}
+{
+}
+
+bool TextParser::NextLine()
+{
+    if (next_line_ == end_)
+        return false;
+
+    line_begin_ = next_line_;
+    const char *newline = static_cast<const char *>(
+            std::memchr(line_begin_, '\n', end_ - line_begin_));
+    line_end_ = newline ? newline : end_;
+    next_line_ = newline ? newline + 1 : end_;
+    position_ = line_begin_;
+    line_number_++;
+    return true;
+}
+
+bool TextParser::NextNonBlankLine()
+{
+    while (NextLine())
+    {
+        if (!AtLineEnd())
+            return true;
+    }
+    return false;
+}
+
+bool TextParser::NextField(TextSpan &field)
+{
+    while (position_ != line_end_ && IsBlank(*position_))
+        ++position_;
+    if (position_ == line_end_)
+        return false;
+
+    field.begin = position_;
+    while (position_ != line_end_ && !IsBlank(*position_))
+        ++position_;
+    field.end = position_;
+    return true;
+}
+
+bool TextParser::AtLineEnd()
+{
+    while (position_ != line_end_ && IsBlank(*position_))
+        ++position_;
+    return position_ == line_end_;
+}
+
+bool TextParser::ReadString(const char *name, std::string &value)
+{
+    TextSpan field;
+    if (!ReadField(name, field))
+        return false;
+
+    value.assign(field.begin, field.end);
+    return true;
+}
+
+bool TextParser::ReadUInt64(const char *name, std::uint64_t &value)
+{
+    TextSpan field;
+    if (!ReadField(name, field))
+        return false;
+    return ParseUInt64(field, value) || FailAt(name, field.begin);
+}
+
+bool TextParser::ReadSize(const char *name, std::size_t &value)
+{
+    TextSpan field;
+    std::uint64_t result;
+    if (!ReadField(name, field))
+        return false;
+    if (!ParseUInt64(field, result) ||
+        result > std::numeric_limits<std::size_t>::max())
+        return FailAt(name, field.begin);
+
+    value = static_cast<std::size_t>(result);
+    return true;
+}
+
+bool TextParser::ReadInt(const char *name, int &value)
+{
+    TextSpan field;
+    if (!ReadField(name, field))
+        return false;
+    return ParseInt(field, value) || FailAt(name, field.begin);
+}
+
+bool TextParser::ReadBool(const char *name, bool &value)
+{
+    TextSpan field;
+    if (!ReadField(name, field))
+        return false;
+    if (field.size() != 1 || (*field.begin != '0' && *field.begin != '1'))
+        return FailAt(name, field.begin);
+
+    value = (*field.begin == '1');
+    return true;
+}
+
+bool TextParser::ReadScore(const char *name, ScoreType &value)
+{
+    TextSpan field;
+    if (!ReadField(name, field))
+        return false;
+    return ParseScore(field, value) || FailAt(name, field.begin);
+}
+
+bool TextParser::ExpectLineEnd()
+{
+    return AtLineEnd() || Fail("end of line");
+}
+
+bool TextParser::ReadStudentInfo(StudentInfo &info)
+{
+    std::uint64_t id;
+    if (!ReadUInt64("student ID", id) ||
+        !ReadString("student name", info.name) ||
+        !ReadBool("gender", info.is_male) ||
+        !ReadInt("department", info.department))
+        return false;
+
+    info.id = id;
+    return true;
+}
+
+bool TextParser::ReadCourseInfo(CourseInfo &info)
+{
+    return ReadString("course ID", info.id) &&
+           ReadString("course name", info.name) &&
+           ReadInt("department", info.department) &&
+           ReadInt("credit", info.credit) &&
+           ReadSize("capacity", info.capacity) &&
+           ReadString("teacher name", info.teacher_name);
+}
+
+bool TextParser::Fail(const char *field)
+{
+    AtLineEnd();  // point at the next field, if any
+    return FailAt(field, position_);
+}
+
+bool TextParser::ReadField(const char *name, TextSpan &field)
+{
+    return NextField(field) || FailAt(name, position_);
+}
+
+bool TextParser::FailAt(const char *field, const char *position)
+{
+    error_.line = line_number_;
+    error_.column = position - line_begin_ + 1;
+    error_.field = field;
+    return false;
+}
+
+}  // namespace SAM
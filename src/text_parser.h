@@ -0,0 +1,105 @@
+#ifndef SAM_TEXT_PARSER_H_
+#define SAM_TEXT_PARSER_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include <string>
+
+#include "common.h"
+
+namespace SAM {
+
+// A piece of a buffer owned by someone else
+struct TextSpan
+{
+    const char *begin;
+    const char *end;
+
+    std::size_t size() const { return end - begin; }
+    bool empty() const { return begin == end; }
+    std::string str() const { return std::string(begin, end); }
+};
+
+// These accept the whole span or nothing, without looking at the locale.
+bool ParseUInt64(TextSpan text, std::uint64_t &value);
+bool ParseInt(TextSpan text, int &value);
+bool ParseScore(TextSpan text, ScoreType &value);
+
+// The other way round, with the same text as to_string() and the stream
+// operators, but without a stream per record.
+void AppendUInt(std::string &out, std::uint64_t value);
+void AppendInt(std::string &out, long long value);
+// precision as for %g: 6 is what ostream prints, 9 keeps every float
+void AppendScore(std::string &out, ScoreType score, int precision = 6);
+void AppendStudentInfo(std::string &out, const StudentInfo &info);
+void AppendCourseInfo(std::string &out, const CourseInfo &info);
+
+// Where and why parsing stopped
+struct ParseError
+{
+    std::size_t line;    // starting from 1, 0 if there is no error
+    std::size_t column;  // in bytes, starting from 1
+    std::string field;   // what was expected there
+
+    // e.g. "line 3, column 12: expected department"
+    std::string ToString() const;
+};
+
+// Split a buffer into lines, and lines into fields separated by blanks,
+// without copying. Fields are read in order, the Read* functions convert
+// them and record an error pointing at the field if they fail.
+class TextParser
+{
+ public:
+    TextParser(const char *begin, const char *end);
+    explicit TextParser(const std::string &text)
+            : TextParser(text.data(), text.data() + text.size()) {}
+
+    // Move to the next line, return false at the end of the buffer
+    bool NextLine();
+    // Skip lines with nothing but blanks
+    bool NextNonBlankLine();
+
+    // Return false if no field is left on this line
+    bool NextField(TextSpan &field);
+    bool AtLineEnd();
+
+    bool ReadString(const char *name, std::string &value);
+    bool ReadUInt64(const char *name, std::uint64_t &value);
+    bool ReadSize(const char *name, std::size_t &value);
+    bool ReadInt(const char *name, int &value);
+    bool ReadBool(const char *name, bool &value);  // 0 or 1
+    bool ReadScore(const char *name, ScoreType &value);
+    // Fail if anything but blanks is left on this line
+    bool ExpectLineEnd();
+
+    bool ReadStudentInfo(StudentInfo &info);
+    bool ReadCourseInfo(CourseInfo &info);
+
+    // Record an error at the current position, or at a field already read.
+    // Always return false.
+    bool Fail(const char *field);
+    bool Fail(const char *field, const TextSpan &where)
+    { return FailAt(field, where.begin); }
+
+    std::size_t line() const { return line_number_; }
+    const char * line_begin() const { return line_begin_; }
+    const ParseError & error() const { return error_; }
+
+ private:
+    bool ReadField(const char *name, TextSpan &field);
+    bool FailAt(const char *field, const char *position);
+
+    const char *next_line_;  // start of the line after the current one
+    const char *end_;
+    const char *line_begin_;
+    const char *line_end_;
+    const char *position_;   // within the current line
+    std::size_t line_number_;
+    ParseError error_;
+};
+
+}  // namespace SAM
+
+#endif  // SAM_TEXT_PARSER_H_
@@ -0,0 +1,86 @@
+// Convert between the text data files and the binary snapshot.
+//
+//     sam_convert to-snapshot <student file> <course file> <snapshot>
+//     sam_convert to-text <snapshot> <student file> <course file> [log]
+//
+// to-text also takes a manifest of segments (sam.manifest) as <snapshot>.
+// With a log (sam.log), the edits logged since the snapshot are included.
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include "../src/io.h"
+#include "../src/mutation_log.h"
+#include "../src/segmented_snapshot.h"
+#include "../src/snapshot.h"
+
+int main(int argc, char *argv[])
+{
+    using namespace SAM;
+
+    Manager manager;
+
+    if (argc == 5 && std::strcmp(argv[1], "to-snapshot") == 0)
+    {
+        if (!ManagerReader().Read(argv[2], argv[3], manager))
+        {
+            std::fprintf(stderr, "Failed to read %s and %s\n",
+                         argv[2], argv[3]);
+            return 1;
+        }
+        if (!SnapshotWriter().Write(argv[4], manager))
+        {
+            std::fprintf(stderr, "Failed to write %s\n", argv[4]);
+            return 1;
+        }
+    }
+    else if ((argc == 5 || argc == 6) && std::strcmp(argv[1], "to-text") == 0)
+    {
+        // a manifest (sam.manifest) or a single snapshot
+        std::uint64_t log_sequence;
+        SegmentedSnapshot segments(argv[2]);
+        SnapshotReader reader;
+        if (segments.Read(manager))
+        {
+            log_sequence = segments.log_sequence();
+        }
+        else if (reader.Read(argv[2], manager))
+        {
+            log_sequence = reader.log_sequence();
+        }
+        else
+        {
+            std::fprintf(stderr, "%s is not a valid snapshot\n", argv[2]);
+            return 1;
+        }
+
+        MutationLog log;
+        LogReplaySummary summary;
+        if (argc == 6 &&
+            !log.Open(argv[5], log_sequence, &manager, summary))
+        {
+            std::fprintf(stderr, "Failed to read %s\n", argv[5]);
+            return 1;
+        }
+        if (!ManagerWriter().Write(argv[3], argv[4], manager))
+        {
+            std::fprintf(stderr, "Failed to write %s and %s\n",
+                         argv[3], argv[4]);
+            return 1;
+        }
+    }
+    else
+    {
+        std::fprintf(stderr,
+                     "Usage: %s to-snapshot <student file> <course file> "
+                     "<snapshot>\n"
+                     "       %s to-text <snapshot> <student file> "
+                     "<course file> [log]\n",
+                     argv[0], argv[0]);
+        return 2;
+    }
+
+    std::printf("%zu students, %zu courses\n",
+                manager.StudentNumber(), manager.CourseNumber());
+    return 0;
+}